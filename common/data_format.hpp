@@ -3,6 +3,10 @@
 #include <iostream>
 #include <chrono>
 #include <memory>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
 #include <boost/optional.hpp>
 
 #include <opencv2/core/mat.hpp>
@@ -24,14 +28,15 @@ namespace ILLIXR {
 	typedef unsigned long long ullong;
 
 	// Data type that combines the IMU and camera data at a certain timestamp.
-	// If there is only IMU data for a certain timestamp, img0 and img1 will be null
+	// If there is only IMU data for a certain timestamp, img0 and img1 will be empty
 	// time is the current UNIX time where dataset_time is the time read from the csv
+	// cv::Mat is itself reference-counted, so the images are freed along with the last copy of this event.
 	typedef struct {
 		time_type time;
 		Eigen::Vector3f angular_v;
 		Eigen::Vector3f linear_a;
-		std::optional<cv::Mat*> img0;
-		std::optional<cv::Mat*> img1;
+		std::optional<cv::Mat> img0;
+		std::optional<cv::Mat> img1;
 		ullong dataset_time;
 	} imu_cam_type;
 
@@ -115,9 +120,166 @@ namespace ILLIXR {
 		int dummy;
 	} hologram_output;
 
-	typedef struct {
-		int seq;		
-	} imu_integrator_seq;
+	// Timestamps for switchboard::subscribe_buffered
+	template <>
+	struct event_time<imu_cam_type> {
+		static time_type get(const imu_cam_type& ev) { return ev.time; }
+	};
+
+	template <>
+	struct event_time<imu_raw_type> {
+		static time_type get(const imu_raw_type& ev) { return ev.imu_time; }
+	};
+
+	template <>
+	struct event_time<pose_type> {
+		static time_type get(const pose_type& ev) { return ev.sensor_time; }
+	};
+
+	// Serialization (see common/serializer.hpp), for recording, replay, and shared memory.
+	template <typename Scalar, int Rows, int Cols, int Options, int MaxRows, int MaxCols>
+	struct field_codec<Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols>> {
+		static_assert(Rows > 0 && Cols > 0, "Only fixed-size Eigen matrices are serializable");
+		static constexpr std::size_t fixed_size = sizeof(Scalar) * Rows * Cols;
+
+		static std::size_t size(const Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols>&) {
+			return fixed_size;
+		}
+
+		static void encode(const Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols>& value, char*& out) {
+			std::memcpy(out, value.data(), fixed_size);
+			out += fixed_size;
+		}
+
+		static bool decode(Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols>& value, const char*& in, const char* end) {
+			if (static_cast<std::size_t>(end - in) < fixed_size) {
+				return false;
+			}
+			std::memcpy(value.data(), in, fixed_size);
+			in += fixed_size;
+			return true;
+		}
+	};
+
+	template <typename Scalar, int Options>
+	struct field_codec<Eigen::Quaternion<Scalar, Options>> {
+		static constexpr std::size_t fixed_size = sizeof(Scalar) * 4;
+
+		static std::size_t size(const Eigen::Quaternion<Scalar, Options>&) {
+			return fixed_size;
+		}
+
+		static void encode(const Eigen::Quaternion<Scalar, Options>& value, char*& out) {
+			std::memcpy(out, value.coeffs().data(), fixed_size);
+			out += fixed_size;
+		}
+
+		static bool decode(Eigen::Quaternion<Scalar, Options>& value, const char*& in, const char* end) {
+			if (static_cast<std::size_t>(end - in) < fixed_size) {
+				return false;
+			}
+			std::memcpy(value.coeffs().data(), in, fixed_size);
+			in += fixed_size;
+			return true;
+		}
+	};
+
+	// rows, cols, and type, then the pixels row by row. Only 2D images.
+	template <>
+	struct field_codec<cv::Mat> {
+		static constexpr std::size_t fixed_size = 0;
+
+		static std::size_t size(const cv::Mat& value) {
+			/* In std::size_t, since int overflows on large frames. */
+			return 3 * sizeof(std::int32_t) + std::size_t(value.rows) * std::size_t(value.cols) * value.elemSize();
+		}
+
+		static void encode(const cv::Mat& value, char*& out) {
+			assert(value.dims <= 2);
+			const std::int32_t header[3] = {value.rows, value.cols, value.type()};
+			std::memcpy(out, header, sizeof(header));
+			out += sizeof(header);
+			const std::size_t row_size = std::size_t(value.cols) * value.elemSize();
+			for (int row = 0; row < value.rows; ++row) {
+				std::memcpy(out, value.ptr(row), row_size);
+				out += row_size;
+			}
+		}
+
+		static bool decode(cv::Mat& value, const char*& in, const char* end) {
+			std::int32_t header[3];
+			if (static_cast<std::size_t>(end - in) < sizeof(header)) {
+				return false;
+			}
+			std::memcpy(header, in, sizeof(header));
+			in += sizeof(header);
+			const std::int32_t rows = header[0];
+			const std::int32_t cols = header[1];
+			const std::int32_t type = header[2];
+			/* A type holds only a depth and a channel count, and the depth must be one OpenCV knows. */
+			if (rows < 0 || cols < 0 || type < 0 || type != CV_MAT_TYPE(type) || CV_MAT_DEPTH(type) > CV_64F) {
+				return false;
+			}
+			/* Check that the pixels are all there before allocating room for them, without overflowing. */
+			const std::size_t row_size = std::size_t(cols) * std::size_t(CV_ELEM_SIZE(type));
+			const std::size_t remaining = static_cast<std::size_t>(end - in);
+			if (rows > 0 && row_size > 0 && remaining / std::size_t(rows) < row_size) {
+				return false;
+			}
+			/* Reuses value's buffer if it already has this size and type. */
+			value.create(rows, cols, type);
+			for (int row = 0; row < value.rows; ++row) {
+				std::memcpy(value.ptr(row), in, row_size);
+				in += row_size;
+			}
+			return true;
+		}
+	};
+
+	template <>
+	struct serializer<imu_cam_type> : fields_serializer<imu_cam_type> {
+		template <typename E>
+		static auto fields(E& ev) { return std::tie(ev.time, ev.angular_v, ev.linear_a, ev.img0, ev.img1, ev.dataset_time); }
+	};
+
+	template <>
+	struct serializer<imu_params> : fields_serializer<imu_params> {
+		template <typename E>
+		static auto fields(E& ev) { return std::tie(ev.gyro_noise, ev.acc_noise, ev.gyro_walk, ev.acc_walk, ev.n_gravity, ev.imu_integration_sigma, ev.nominal_rate); }
+	};
+
+	template <>
+	struct serializer<imu_integrator_input> : fields_serializer<imu_integrator_input> {
+		template <typename E>
+		static auto fields(E& ev) { return std::tie(ev.last_cam_integration_time, ev.t_offset, ev.params, ev.biasAcc, ev.biasGyro, ev.position, ev.velocity, ev.quat); }
+	};
+
+	template <>
+	struct serializer<imu_raw_type> : fields_serializer<imu_raw_type> {
+		template <typename E>
+		static auto fields(E& ev) { return std::tie(ev.w_hat, ev.a_hat, ev.w_hat2, ev.a_hat2, ev.pos, ev.vel, ev.quat, ev.imu_time); }
+	};
+
+	template <>
+	struct serializer<pose_type> : fields_serializer<pose_type> {
+		template <typename E>
+		static auto fields(E& ev) { return std::tie(ev.sensor_time, ev.position, ev.orientation); }
+	};
+
+	template <>
+	struct serializer<fast_pose_type> : fields_serializer<fast_pose_type> {
+		template <typename E>
+		static auto fields(E& ev) { return std::tie(ev.pose, ev.predict_computed_time, ev.predict_target_time); }
+	};
+
+	template <>
+	struct serializer<hologram_input> : trivial_serializer<hologram_input> { };
+
+	template <>
+	struct serializer<hologram_output> : trivial_serializer<hologram_output> { };
+
+	template <>
+	struct serializer<time_type> : trivial_serializer<time_type> { };
 
 	/* I use "accel" instead of "3-vector" as a datatype, because
 	this checks that you meant to use an acceleration in a certain
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "phonebook.hpp"
+#include "thread_config.hpp"
+
+namespace ILLIXR {
+
+/**
+ * @brief A pool of workers, sized to the machine, which runs short tasks.
+ *
+ * With `ILLIXR_EXECUTOR=y`, the runtime registers one, and switchboard callbacks and the
+ * iterations of threadloops which opt in (see `threadloop::run_as_tasks()`) run on it as tasks,
+ * instead of each on its own thread. This keeps the number of threads near the number of cores,
+ * which saves context switches on small machines. `ILLIXR_EXECUTOR_THREADS` overrides the number
+ * of workers, and the `executor` thread_config (see thread_config.hpp) schedules them.
+ *
+ * Each worker has its own deque. A worker pushes the tasks it submits to the back of its own,
+ * and takes from the back (so a task's continuation runs while its data is still in cache); an
+ * idle worker steals from the front of the others'. Tasks submitted from other threads are dealt
+ * round-robin, into a separate first-in first-out inbox per worker.
+ *
+ * Fairness: a worker takes its oldest task (from its inbox first, then the front of its deque)
+ * once every LIFO_BURST tasks, so a task which keeps resubmitting itself (e.g. a threadloop's next
+ * step) delays older ones by at most LIFO_BURST tasks, rather than starving them.
+ *
+ * Tasks should not block for long; a blocked task holds up a worker. In particular, a task which
+ * publishes to a full `overflow_policy::block` queue waits for a drain task which may need the
+ * very worker it holds, so with every worker blocked like this, the executor deadlocks. Topics
+ * written from tasks should drop instead.
+ *
+ * Proof of thread-safety:
+ * - Each worker's deque and inbox are only accessed under its lock, which is not held while a task runs.
+ * - _m_timers is only accessed under _m_sleep_lock.
+ * - No lost wakeups: a worker increments _m_sleepers before checking _m_queued under
+ *   _m_sleep_lock, and submit increments _m_queued before checking _m_sleepers (both sequentially
+ *   consistent). So either the worker sees the task, or submit sees it sleeping, acquires the lock
+ *   (so it is either before its check or already waiting), and notifies.
+ */
+class executor : public phonebook::service {
+public:
+	typedef std::function<void()> task;
+
+	/**
+	 * @brief Whether the runtime should run tasks on an executor, from `ILLIXR_EXECUTOR`.
+	 */
+	static bool enabled() {
+		const char* ILLIXR_EXECUTOR = std::getenv("ILLIXR_EXECUTOR");
+		return ILLIXR_EXECUTOR && std::strcmp(ILLIXR_EXECUTOR, "y") == 0;
+	}
+
+	static std::size_t threads_from_env() {
+		if (const char* ILLIXR_EXECUTOR_THREADS = std::getenv("ILLIXR_EXECUTOR_THREADS")) {
+			return std::max(std::size_t{1}, static_cast<std::size_t>(std::stoul(std::string{ILLIXR_EXECUTOR_THREADS})));
+		}
+		return std::max(1U, std::thread::hardware_concurrency());
+	}
+
+	explicit executor(std::size_t threads = threads_from_env()) {
+		const thread_config sched = thread_config::from_env("executor");
+		for (std::size_t i = 0; i < threads; ++i) {
+			_m_workers.push_back(std::make_unique<worker>());
+		}
+		for (std::size_t i = 0; i < threads; ++i) {
+			_m_threads.push_back(std::thread{[this, i, sched]() {
+				sched.apply("exec_" + std::to_string(i));
+				std::cout << "thread," << std::this_thread::get_id() << ",executor," << i << std::endl;
+				this->work(i);
+			}});
+		}
+	}
+
+	/**
+	 * @brief Joins the workers. Queued tasks (and timers) are dropped, with a warning, and later ones are ignored.
+	 */
+	void stop() {
+		if (!_m_terminate.exchange(true)) {
+			{
+				const std::lock_guard<std::mutex> lock{_m_sleep_lock};
+			}
+			_m_wake_cv.notify_all();
+			for (std::thread& thread : _m_threads) {
+				thread.join();
+			}
+			/* Tasks may own things which own me (e.g. a threadloop's next step), so drop them now, rather than in my destructor. */
+			std::size_t dropped = 0;
+			for (std::unique_ptr<worker>& w : _m_workers) {
+				dropped += w->tasks.size() + w->inbox.size();
+				w->tasks.clear();
+				w->inbox.clear();
+			}
+			{
+				const std::lock_guard<std::mutex> lock{_m_sleep_lock};
+				dropped += _m_timers.size();
+				_m_timers = decltype(_m_timers){};
+			}
+			if (dropped > 0) {
+				std::cerr << "Executor stopped with " << dropped << " tasks still queued; they were dropped" << std::endl;
+			}
+		}
+	}
+
+	virtual ~executor() override {
+		stop();
+	}
+
+	void submit(task t) {
+		if (_m_terminate.load()) {
+			return;
+		}
+		const current_worker& me = current();
+		if (me.owner == this) {
+			worker& w = *_m_workers[me.index];
+			const std::lock_guard<std::mutex> lock{w.lock};
+			w.tasks.push_back(std::move(t));
+		} else {
+			worker& w = *_m_workers[_m_next_worker++ % _m_workers.size()];
+			const std::lock_guard<std::mutex> lock{w.lock};
+			w.inbox.push_back(std::move(t));
+		}
+		_m_queued++;
+		if (_m_sleepers.load() > 0) {
+			{
+				const std::lock_guard<std::mutex> lock{_m_sleep_lock};
+			}
+			_m_wake_cv.notify_one();
+		}
+	}
+
+	/**
+	 * @brief Submits @p t at @p time (or right away, if it has passed).
+	 *
+	 * An idle worker wakes up for it, like a condition variable would, so it can run some tens of
+	 * microseconds late.
+	 */
+	void submit_at(std::chrono::steady_clock::time_point time, task t) {
+		if (_m_terminate.load()) {
+			return;
+		}
+		{
+			const std::lock_guard<std::mutex> lock{_m_sleep_lock};
+			_m_timers.push(timer{time, std::move(t)});
+			_m_next_timer.store(_m_timers.top().time);
+		}
+		/* It may be earlier than what the sleeping workers are waiting for. */
+		_m_wake_cv.notify_one();
+	}
+
+	std::size_t size() const {
+		return _m_workers.size();
+	}
+
+private:
+	/* How many tasks a worker may take from the back of its deque before it takes its oldest one. */
+	static constexpr std::size_t LIFO_BURST = 16;
+
+	struct worker {
+		std::mutex lock;
+		/* Submitted by this worker's own tasks. */
+		std::deque<task> tasks;
+		/* Submitted from outside the pool. */
+		std::deque<task> inbox;
+		/* Tasks taken since this worker last took its oldest one. Only used by the worker itself. */
+		std::size_t burst = 0;
+	};
+
+	struct timer {
+		std::chrono::steady_clock::time_point time;
+		task t;
+
+		bool operator>(const timer& other) const {
+			return time > other.time;
+		}
+	};
+
+	/* Which executor (if any) the calling thread works for, so submit can use its own deque. */
+	struct current_worker {
+		const executor* owner = nullptr;
+		std::size_t index = 0;
+	};
+	static current_worker& current() {
+		thread_local current_worker me;
+		return me;
+	}
+
+	void work(std::size_t index) {
+		current() = current_worker{this, index};
+		task t;
+		while (!_m_terminate.load()) {
+			release_timers();
+			if (take(index, t)) {
+				_m_queued--;
+				t();
+				/* Release whatever the task captured before sleeping. */
+				t = nullptr;
+				continue;
+			}
+			_m_sleepers++;
+			{
+				/* Waits once, rather than until ready, so that a new earlier timer (see submit_at) shortens the wait. */
+				std::unique_lock<std::mutex> lock{_m_sleep_lock};
+				if (_m_queued.load() <= 0 && !_m_terminate.load() && !timer_due()) {
+					if (_m_timers.empty()) {
+						_m_wake_cv.wait(lock);
+					} else {
+						_m_wake_cv.wait_until(lock, _m_timers.top().time);
+					}
+				}
+			}
+			_m_sleepers--;
+		}
+	}
+
+	/**
+	 * @brief Takes a task from the back of my deque (or, every LIFO_BURST tasks, my oldest one), or
+	 * else steals the oldest one of another worker.
+	 */
+	bool take(std::size_t index, task& t) {
+		worker& me = *_m_workers[index];
+		{
+			const std::lock_guard<std::mutex> lock{me.lock};
+			if (me.burst >= LIFO_BURST || me.tasks.empty()) {
+				if (take_oldest(me, t)) {
+					me.burst = 0;
+					return true;
+				}
+			} else {
+				t = std::move(me.tasks.back());
+				me.tasks.pop_back();
+				me.burst++;
+				return true;
+			}
+		}
+		for (std::size_t i = 1; i < _m_workers.size(); ++i) {
+			worker& w = *_m_workers[(index + i) % _m_workers.size()];
+			const std::lock_guard<std::mutex> lock{w.lock};
+			if (take_oldest(w, t)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/* Call under w.lock. The inbox comes first, since its tasks have waited longest to be looked at. */
+	static bool take_oldest(worker& w, task& t) {
+		std::deque<task>& from = w.inbox.empty() ? w.tasks : w.inbox;
+		if (from.empty()) {
+			return false;
+		}
+		t = std::move(from.front());
+		from.pop_front();
+		return true;
+	}
+
+	bool timer_due() const {
+		return _m_next_timer.load() <= std::chrono::steady_clock::now();
+	}
+
+	/**
+	 * @brief Submits the timers which are due.
+	 */
+	void release_timers() {
+		/* Checked without the lock first, since this runs between every two tasks. */
+		if (!timer_due()) {
+			return;
+		}
+		std::vector<task> due;
+		{
+			const std::lock_guard<std::mutex> lock{_m_sleep_lock};
+			const auto now = std::chrono::steady_clock::now();
+			while (!_m_timers.empty() && _m_timers.top().time <= now) {
+				/* top() is const, but the timer is popped right after. */
+				due.push_back(std::move(const_cast<timer&>(_m_timers.top()).t));
+				_m_timers.pop();
+			}
+			_m_next_timer.store(_m_timers.empty() ? std::chrono::steady_clock::time_point::max() : _m_timers.top().time);
+		}
+		for (task& t : due) {
+			submit(std::move(t));
+		}
+	}
+
+	std::vector<std::unique_ptr<worker>> _m_workers;
+	std::vector<std::thread> _m_threads;
+	std::atomic<std::size_t> _m_next_worker {0};
+	/* Signed: a task can be taken before its submitter counts it. */
+	std::atomic<std::int64_t> _m_queued {0};
+	std::atomic<std::size_t> _m_sleepers {0};
+	std::atomic<bool> _m_terminate {false};
+
+	std::mutex _m_sleep_lock;
+	std::condition_variable _m_wake_cv;
+	std::priority_queue<timer, std::vector<timer>, std::greater<timer>> _m_timers;
+	/* The earliest timer, readable without _m_sleep_lock. */
+	std::atomic<std::chrono::steady_clock::time_point> _m_next_timer {std::chrono::steady_clock::time_point::max()};
+};
+
+}
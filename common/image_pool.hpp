@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+namespace ILLIXR {
+
+/**
+ * @brief A fixed set of image buffers, reused from frame to frame.
+ *
+ * Frames come out of `borrow()` as ordinary `cv::Mat`s, so subscribers need no changes. Since
+ * `cv::Mat` is reference-counted, whoever holds the frame (or an event containing it) holds the
+ * buffer; it returns to the pool when the last `cv::Mat` referencing it is destroyed.
+ *
+ * The buffers are allocated on the first `borrow()`, each the size of that first frame. If every
+ * buffer is out, or a frame has a different size, `borrow()` falls back to the heap instead of
+ * blocking the producer. These misses are counted, and printed when the pool is destroyed.
+ *
+ * Proof of thread-safety:
+ * - Frames are released in whichever thread drops the last reference, so the free list is
+ *   guarded by a lock. It is only held to push or pop a pointer.
+ * - Frames may outlive the pool (e.g. as a topic's latest event), so the allocator which
+ *   `cv::Mat` calls back into frees itself after both the pool and the last frame are gone.
+ */
+class image_pool {
+public:
+	explicit image_pool(std::size_t capacity)
+		: _m_allocator{new allocator{capacity}}
+	{ }
+
+	image_pool(const image_pool&) = delete;
+	image_pool& operator=(const image_pool&) = delete;
+
+	~image_pool() {
+		_m_allocator->release();
+	}
+
+	/**
+	 * @brief Borrows a buffer for a frame which @p fill writes, e.g. with `cv::imdecode(buf, flags, &mat)`.
+	 *
+	 * @p fill gets an empty `cv::Mat`, and must `create()` it at its final size before writing to it.
+	 */
+	template <typename Fill>
+	cv::Mat borrow(Fill&& fill) {
+		cv::Mat mat;
+		mat.allocator = _m_allocator;
+		fill(mat);
+		/* The buffer remembers its allocator; copies of the frame should not. */
+		mat.allocator = nullptr;
+		return mat;
+	}
+
+	cv::Mat borrow(int rows, int cols, int type) {
+		return borrow([=](cv::Mat& mat) {
+			mat.create(rows, cols, type);
+		});
+	}
+
+	std::size_t misses() const {
+		return _m_allocator->misses();
+	}
+
+private:
+#if CV_VERSION_MAJOR >= 4
+	using access_flags = cv::AccessFlag;
+#else
+	using access_flags = int;
+#endif
+
+	class allocator : public cv::MatAllocator {
+	public:
+		explicit allocator(std::size_t capacity)
+			: _m_capacity{capacity}
+		{ }
+
+		virtual cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, std::size_t* step, access_flags, cv::UMatUsageFlags) const override {
+			/* Same (dense) layout as OpenCV's default allocator. */
+			std::size_t total = CV_ELEM_SIZE(type);
+			for (int i = dims - 1; i >= 0; --i) {
+				if (step) {
+					if (data && step[i] != CV_AUTOSTEP) {
+						total = step[i];
+					} else {
+						step[i] = total;
+					}
+				}
+				total *= sizes[i];
+			}
+
+			cv::UMatData* u = new cv::UMatData{this};
+			u->size = total;
+			if (data) {
+				u->flags |= cv::UMatData::USER_ALLOCATED;
+				u->data = u->origdata = static_cast<uchar*>(data);
+			} else {
+				/* userdata marks a pooled buffer; null means it came from the heap. */
+				u->userdata = take(total);
+				u->data = u->origdata = static_cast<uchar*>(u->userdata ? u->userdata : cv::fastMalloc(total));
+			}
+
+			const std::lock_guard<std::mutex> lock{_m_lock};
+			_m_outstanding++;
+			return u;
+		}
+
+		virtual bool allocate(cv::UMatData* u, access_flags, cv::UMatUsageFlags) const override {
+			return u != nullptr;
+		}
+
+		virtual void deallocate(cv::UMatData* u) const override {
+			if (!u) {
+				return;
+			}
+			bool last;
+			{
+				const std::lock_guard<std::mutex> lock{_m_lock};
+				if (u->userdata) {
+					_m_free.push_back(u->userdata);
+				} else if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+					cv::fastFree(u->origdata);
+				}
+				_m_outstanding--;
+				last = _m_released && _m_outstanding == 0;
+			}
+			delete u;
+			if (last) {
+				delete this;
+			}
+		}
+
+		/* Called once, by the pool's destructor. */
+		void release() {
+			bool last;
+			{
+				const std::lock_guard<std::mutex> lock{_m_lock};
+				_m_released = true;
+				last = _m_outstanding == 0;
+			}
+			if (last) {
+				delete this;
+			}
+		}
+
+		std::size_t misses() const {
+			const std::lock_guard<std::mutex> lock{_m_lock};
+			return _m_misses;
+		}
+
+		virtual ~allocator() override {
+			/* No need for thread-safety: the pool and every frame are gone. */
+			for (void* block : _m_free) {
+				cv::fastFree(block);
+			}
+			if (_m_misses > 0) {
+				std::cerr << "image_pool: " << _m_misses << " frames did not fit in the pool of " << _m_capacity << std::endl;
+			}
+		}
+
+	private:
+		void* take(std::size_t size) const {
+			const std::lock_guard<std::mutex> lock{_m_lock};
+			if (_m_block_size == 0) {
+				_m_block_size = size;
+				_m_free.reserve(_m_capacity);
+				for (std::size_t i = 0; i < _m_capacity; ++i) {
+					_m_free.push_back(cv::fastMalloc(size));
+				}
+			}
+			if (size == _m_block_size && !_m_free.empty()) {
+				void* block = _m_free.back();
+				_m_free.pop_back();
+				return block;
+			}
+			_m_misses++;
+			return nullptr;
+		}
+
+		/* cv::MatAllocator's interface is const, so all state is mutable. */
+		const std::size_t _m_capacity;
+		mutable std::mutex _m_lock;
+		mutable std::vector<void*> _m_free;
+		mutable std::size_t _m_block_size = 0;
+		mutable std::size_t _m_outstanding = 0;
+		mutable std::size_t _m_misses = 0;
+		mutable bool _m_released = false;
+	};
+
+	allocator* const _m_allocator;
+};
+
+}
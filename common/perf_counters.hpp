@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ILLIXR {
+
+/**
+ * @brief The calling thread's hardware performance counters, from `perf_event_open`.
+ *
+ * Off unless `ILLIXR_PERF_COUNTERS=y`. Then threadloop iterations and switchboard callbacks
+ * record how many cycles, instructions, cache misses, and context switches they took, which
+ * tells compute-bound (high instructions per cycle) from memory-bound (many misses) code.
+ *
+ * Counters which the kernel refuses (e.g. because of `kernel.perf_event_paranoid`, or in a VM
+ * without a PMU) read as 0. The counters are read together in one system call.
+ *
+ * Counts only the thread which opened them, so use `this_thread()`.
+ */
+class perf_counters {
+public:
+	struct sample {
+		std::uint64_t cycles = 0;
+		std::uint64_t instructions = 0;
+		std::uint64_t cache_misses = 0;
+		std::uint64_t context_switches = 0;
+
+		sample operator-(const sample& other) const {
+			return sample{
+				cycles - other.cycles,
+				instructions - other.instructions,
+				cache_misses - other.cache_misses,
+				context_switches - other.context_switches,
+			};
+		}
+	};
+
+	static bool enabled() {
+		const char* ILLIXR_PERF_COUNTERS = std::getenv("ILLIXR_PERF_COUNTERS");
+		return ILLIXR_PERF_COUNTERS && std::strcmp(ILLIXR_PERF_COUNTERS, "y") == 0;
+	}
+
+	/**
+	 * @brief The calling thread's counters, opened on first use.
+	 */
+	static perf_counters& this_thread() {
+		thread_local perf_counters counters;
+		return counters;
+	}
+
+	perf_counters() {
+		if (!enabled()) {
+			return;
+		}
+		open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, &sample::cycles);
+		open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, &sample::instructions);
+		open("cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, &sample::cache_misses);
+		open("context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, &sample::context_switches);
+		if (_m_fds.empty()) {
+			return;
+		}
+		ioctl(_m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	perf_counters(const perf_counters&) = delete;
+	perf_counters& operator=(const perf_counters&) = delete;
+
+	~perf_counters() {
+		for (int fd : _m_fds) {
+			close(fd);
+		}
+	}
+
+	/**
+	 * @brief The counts since the counters were opened. Subtract two samples to count what ran in between.
+	 */
+	sample read() const {
+		sample ret;
+		if (_m_fds.empty()) {
+			return ret;
+		}
+		/* The layout of PERF_FORMAT_GROUP: the number of counters, then their values in the order they were opened. */
+		struct {
+			std::uint64_t nr;
+			std::uint64_t values[COUNTERS];
+		} group;
+		if (::read(_m_fds[0], &group, sizeof(group)) < static_cast<ssize_t>(sizeof(group.nr))) {
+			return ret;
+		}
+		for (std::size_t i = 0; i < group.nr && i < _m_fds.size(); ++i) {
+			ret.*_m_fields[i] = group.values[i];
+		}
+		return ret;
+	}
+
+private:
+	static constexpr std::size_t COUNTERS = 4;
+
+	/**
+	 * @brief Opens a counter in the group led by the first one opened. Skips it, with a warning, if the kernel refuses.
+	 */
+	void open(const char* name, std::uint32_t type, std::uint64_t config, std::uint64_t sample::* field) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.read_format = PERF_FORMAT_GROUP;
+		/* The group starts together, once every counter is in. */
+		attr.disabled = _m_fds.empty() ? 1 : 0;
+		/* Unprivileged users may only count user-space; context switches happen in the kernel, but are counted either way. */
+		attr.exclude_kernel = type == PERF_TYPE_HARDWARE ? 1 : 0;
+		attr.exclude_hv = 1;
+		const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1 /* any CPU */, _m_fds.empty() ? -1 : _m_fds[0], 0));
+		if (fd < 0) {
+			std::cerr << "Could not open the " << name << " perf counter: " << std::strerror(errno) << std::endl;
+			return;
+		}
+		_m_fields[_m_fds.size()] = field;
+		_m_fds.push_back(fd);
+	}
+
+	/* The first is the group leader, through which all of them are read. */
+	std::vector<int> _m_fds;
+	std::array<std::uint64_t sample::*, COUNTERS> _m_fields {};
+};
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <time.h>
+#include "record_logger.hpp"
+
+namespace ILLIXR {
+
+const record_header __precise_sleep_header {"precise_sleep", {
+	{"name", typeid(std::string)},
+	{"requested", typeid(std::chrono::nanoseconds)},
+	{"spin", typeid(std::chrono::nanoseconds)},
+	{"overshoot", typeid(std::chrono::nanoseconds)},
+}};
+
+/**
+ * @brief Sleeps until a deadline, waking up closer to it than `std::this_thread::sleep_until`.
+ *
+ * Like Monado, this sleeps for most of the wait (with `clock_nanosleep(TIMER_ABSTIME)`, so
+ * time spent in the call itself does not add up), and spins for the rest. The spin is only as
+ * long as `clock_nanosleep` has recently been late on this machine, so it adapts to the kernel's
+ * timer slack and to load.
+ *
+ * Each sleep logs a `precise_sleep` record of how long it spun, and how late it still woke up
+ * (its overshoot). The overshoot comes straight out of a frame-paced loop's margin.
+ *
+ * Not thread-safe; each thread should have its own.
+ */
+class precise_sleeper {
+public:
+	precise_sleeper(std::string name, std::shared_ptr<record_logger> record_logger_)
+		: _m_name{std::move(name)}
+		, _m_log{record_logger_}
+	{ }
+
+	/**
+	 * @brief Returns at @p target (or right away, if it has passed), on any clock.
+	 *
+	 * @return the overshoot.
+	 */
+	template <typename Clock, typename Duration>
+	std::chrono::nanoseconds sleep_until(std::chrono::time_point<Clock, Duration> target) {
+		if constexpr (std::is_same_v<Clock, std::chrono::steady_clock>) {
+			return sleep_until_steady(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(target));
+		} else {
+			return sleep_for(target - Clock::now());
+		}
+	}
+
+	template <typename Rep, typename Period>
+	std::chrono::nanoseconds sleep_for(const std::chrono::duration<Rep, Period>& duration) {
+		return sleep_until_steady(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+	}
+
+	/**
+	 * @brief How long before a deadline this stops sleeping and starts spinning.
+	 */
+	std::chrono::nanoseconds spin_margin() const {
+		return _m_margin;
+	}
+
+private:
+	/* Bounds on the spin margin: below the minimum, the clock reads alone would be late; above the
+	   maximum, a stall is not worth burning a core for. */
+	static constexpr std::chrono::nanoseconds MIN_MARGIN {20'000};
+	static constexpr std::chrono::nanoseconds MAX_MARGIN {2'000'000};
+
+	std::chrono::nanoseconds sleep_until_steady(std::chrono::steady_clock::time_point target) {
+		const auto start = std::chrono::steady_clock::now();
+		if (target <= start) {
+			return std::chrono::nanoseconds{0};
+		}
+
+		const auto wake = target - _m_margin;
+		if (wake > start) {
+			/* steady_clock is CLOCK_MONOTONIC. */
+			const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(wake.time_since_epoch());
+			struct timespec ts;
+			ts.tv_sec = since_epoch.count() / 1'000'000'000;
+			ts.tv_nsec = since_epoch.count() % 1'000'000'000;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) { }
+			calibrate(std::chrono::steady_clock::now() - wake);
+		}
+
+		const auto spin_start = std::chrono::steady_clock::now();
+		auto now = spin_start;
+		while (now < target) {
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+			now = std::chrono::steady_clock::now();
+		}
+
+		const auto overshoot = std::chrono::duration_cast<std::chrono::nanoseconds>(now - target);
+		_m_log.log(record{__precise_sleep_header, {
+			{_m_name},
+			{std::chrono::duration_cast<std::chrono::nanoseconds>(target - start)},
+			{std::chrono::duration_cast<std::chrono::nanoseconds>(now - spin_start)},
+			{overshoot},
+		}});
+		return overshoot;
+	}
+
+	/* Tracks how late clock_nanosleep wakes up, with moving averages of the lateness and of its
+	   deviation (like TCP's round-trip estimator), and spins for the average plus 4 deviations. */
+	void calibrate(std::chrono::steady_clock::duration lateness) {
+		const double sample = std::chrono::duration<double, std::nano>(lateness).count();
+		_m_lateness_ns += (sample - _m_lateness_ns) / 8;
+		_m_deviation_ns += (std::abs(sample - _m_lateness_ns) - _m_deviation_ns) / 8;
+		_m_margin = std::clamp(
+			std::chrono::nanoseconds{static_cast<std::int64_t>(_m_lateness_ns + 4 * _m_deviation_ns)},
+			MIN_MARGIN,
+			MAX_MARGIN
+		);
+	}
+
+	const std::string _m_name;
+	record_coalescer _m_log;
+	/* Starts out generous, and settles within a few dozen sleeps. */
+	double _m_lateness_ns = 100'000;
+	double _m_deviation_ns = 25'000;
+	std::chrono::nanoseconds _m_margin {200'000};
+};
+
+}
@@ -2,8 +2,15 @@
 
 #include <any>
 #include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <optional>
 #include <unordered_map>
 #include <sstream>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 #include <memory>
 #include "phonebook.hpp"
@@ -106,7 +113,8 @@ namespace ILLIXR {
 	public:
 		record(const record_header& rh_, std::vector<std::any> values_)
 			: rh{rh_}
-			, values{values_}
+			  // Parentheses, not braces: list-initialization would prefer wrapping values_ in a single std::any.
+			, values(std::move(values_))
 		{
 #ifndef NDEBUG
 			assert(rh);
@@ -176,6 +184,137 @@ namespace ILLIXR {
 #endif
     };
 
+	/**
+	 * @brief Rows of one record_header, stored column by column.
+	 *
+	 * Column `i` is an array of `size()` values of `get_record_header().get_column_type(i)`, so a
+	 * logger can read it directly, without boxing each value as a `record` does.
+	 * See `typed_record_coalescer`, which fills these.
+	 */
+	class record_batch {
+	public:
+		virtual ~record_batch() { }
+
+		virtual const record_header& get_record_header() const = 0;
+
+		virtual std::size_t size() const = 0;
+
+		/**
+		 * @brief The first of `size()` values of @p column's type.
+		 */
+		virtual const void* column_data(unsigned column) const = 0;
+
+		template <typename T>
+		const T& get_value(std::size_t row, unsigned column) const {
+			assert(get_record_header().get_column_type(column) == typeid(T));
+			assert(row < size());
+			return static_cast<const T*>(column_data(column))[row];
+		}
+
+		/**
+		 * @brief Boxes @p row into a record, for loggers which only take those.
+		 */
+		record get_record(std::size_t row) const {
+			std::vector<std::any> values;
+			values.reserve(get_record_header().get_columns());
+			for (unsigned column = 0; column < get_record_header().get_columns(); ++column) {
+				values.push_back(get_any(row, column));
+			}
+			return record{get_record_header(), std::move(values)};
+		}
+
+	protected:
+		virtual std::any get_any(std::size_t row, unsigned column) const = 0;
+	};
+
+	/**
+	 * @brief A record_batch whose columns are @p Columns (which must match its record_header).
+	 *
+	 * All of its storage is allocated up front, so `push` does not allocate (except for a string
+	 * longer than the one in the slot it overwrites).
+	 */
+	template <typename... Columns>
+	class typed_record_batch : public record_batch {
+	public:
+		typed_record_batch(const record_header& rh_, std::size_t capacity)
+			: _m_rh{rh_}
+			, _m_capacity{capacity}
+			, _m_columns{std::make_unique<Columns[]>(capacity)...}
+		{
+#ifndef NDEBUG
+			const std::type_info* types[] = {&typeid(Columns)...};
+			if (sizeof...(Columns) != _m_rh.get_columns()) {
+				std::cerr << sizeof...(Columns) << " columns passed, but rh for " << _m_rh.get_name() << " specifies " << _m_rh.get_columns() << "." << std::endl;
+				abort();
+			}
+			for (unsigned column = 0; column < sizeof...(Columns); ++column) {
+				if (*types[column] != _m_rh.get_column_type(column)) {
+					std::cerr << "Wrong type for column " << column << " of " << _m_rh.get_name() << ". "
+							  << "Caller passed: " << types[column]->name() << "; "
+							  << "record_header specifies: " << _m_rh.get_column_type(column).name() << "."
+							  << std::endl;
+					abort();
+				}
+			}
+#endif
+		}
+
+		/**
+		 * @brief Appends a row. The caller must check `full()` first.
+		 */
+		void push(const Columns&... values) {
+			assert(!full());
+			push(std::index_sequence_for<Columns...>{}, values...);
+			_m_size++;
+		}
+
+		bool full() const {
+			return _m_size == _m_capacity;
+		}
+
+		virtual const record_header& get_record_header() const override {
+			return _m_rh;
+		}
+
+		virtual std::size_t size() const override {
+			return _m_size;
+		}
+
+		virtual const void* column_data(unsigned column) const override {
+			return column_data(std::index_sequence_for<Columns...>{}, column);
+		}
+
+	protected:
+		virtual std::any get_any(std::size_t row, unsigned column) const override {
+			return get_any(std::index_sequence_for<Columns...>{}, row, column);
+		}
+
+	private:
+		template <std::size_t... I>
+		void push(std::index_sequence<I...>, const Columns&... values) {
+			((std::get<I>(_m_columns)[_m_size] = values), ...);
+		}
+
+		template <std::size_t... I>
+		const void* column_data(std::index_sequence<I...>, unsigned column) const {
+			const void* ret = nullptr;
+			((I == column ? (void) (ret = std::get<I>(_m_columns).get()) : (void) 0), ...);
+			return ret;
+		}
+
+		template <std::size_t... I>
+		std::any get_any(std::index_sequence<I...>, std::size_t row, unsigned column) const {
+			std::any ret;
+			((I == column ? (void) (ret = std::get<I>(_m_columns)[row]) : (void) 0), ...);
+			return ret;
+		}
+
+		const record_header& _m_rh;
+		const std::size_t _m_capacity;
+		std::size_t _m_size = 0;
+		std::tuple<std::unique_ptr<Columns[]>...> _m_columns;
+	};
+
 	/**
 	 * @brief The ILLIXR logging service for structured records.
 	 *
@@ -204,6 +343,20 @@ namespace ILLIXR {
 				log(r);
 			}
 		}
+
+		/**
+		 * @brief Writes a batch of rows, taking ownership of it (so that it can be written later, from another thread).
+		 *
+		 * This boxes each row into a record. Loggers which can read the columns directly should override it.
+		 */
+		virtual void log(std::unique_ptr<const record_batch> batch) {
+			std::vector<record> rs;
+			rs.reserve(batch->size());
+			for (std::size_t row = 0; row < batch->size(); ++row) {
+				rs.push_back(batch->get_record(row));
+			}
+			log(rs);
+		}
 	};
 
 	/**
@@ -318,4 +471,59 @@ namespace ILLIXR {
 			last_log = std::chrono::high_resolution_clock::now();
 		}
 	};
+
+	/**
+	 * @brief Like record_coalescer, but for a record_header whose column types are known
+	 * statically, as @p Columns.
+	 *
+	 * Rows are written straight into a preallocated typed_record_batch, so logging one does not
+	 * touch the heap, or box any value. The batch is handed to the logger when it is full, or
+	 * like record_coalescer, once a second; only then is the next one allocated.
+	 *
+	 * Use like:
+	 *
+	 * \code{.cpp}
+	 * typed_record_coalescer<std::size_t, std::chrono::nanoseconds> lc {logger, my_record_header};
+	 * lc.log(id, duration);
+	 * \endcode
+	 */
+	template <typename... Columns>
+	class typed_record_coalescer {
+	public:
+		static constexpr std::size_t DEFAULT_CAPACITY = 1024;
+
+		typed_record_coalescer(std::shared_ptr<record_logger> logger_, const record_header& rh_, std::size_t capacity_ = DEFAULT_CAPACITY)
+			: logger{std::move(logger_)}
+			, rh{rh_}
+			, capacity{capacity_}
+			, batch{std::make_unique<typed_record_batch<Columns...>>(rh, capacity)}
+			, last_log{std::chrono::high_resolution_clock::now()}
+		{ }
+
+		~typed_record_coalescer() {
+			flush();
+		}
+
+		void log(const Columns&... values) {
+			batch->push(values...);
+			if (batch->full() || std::chrono::high_resolution_clock::now() > last_log + LOG_BUFFER_DELAY) {
+				flush();
+			}
+		}
+
+		void flush() {
+			if (batch->size() > 0) {
+				logger->log(std::unique_ptr<const record_batch>{std::move(batch)});
+				batch = std::make_unique<typed_record_batch<Columns...>>(rh, capacity);
+			}
+			last_log = std::chrono::high_resolution_clock::now();
+		}
+
+	private:
+		std::shared_ptr<record_logger> logger;
+		const record_header& rh;
+		const std::size_t capacity;
+		std::unique_ptr<typed_record_batch<Columns...>> batch;
+		std::chrono::time_point<std::chrono::high_resolution_clock> last_log;
+	};
 }
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+
+namespace ILLIXR {
+
+/**
+ * @brief How one field of an event is encoded. Specialize this for field types which are not
+ * trivially copyable (data_format.hpp does this for Eigen and OpenCV types).
+ *
+ * Every codec has:
+ * - `fixed_size`: the encoded size of every value, or 0 if it depends on the value.
+ * - `size(value)`: the encoded size of @p value.
+ * - `encode(value, out)`: writes `size(value)` bytes at @p out, and advances it.
+ * - `decode(value, in, end)`: reads into @p value from @p in, and advances it. Returns false if
+ *   [in, end) is too short or malformed.
+ *
+ * None of them allocate, except when decoding into a value which must grow (e.g. a `cv::Mat`).
+ */
+template <typename T, typename Enable = void>
+struct field_codec;
+
+/**
+ * @brief Serialization of an event type, for tools which handle events without knowing
+ * their type (recording, replay, shared memory).
+ *
+ * A serializer has `enabled`, `fixed_size()` (the encoded size of every event, or 0 if it varies),
+ * `size(ev)`, `encode(ev, out)` (writes `size(ev)` bytes), and `decode(in, size, ev)` (returns false
+ * if the bytes are malformed). It may also have `layout()`, which identifies the encoding, so that
+ * a recording made with another layout is not decoded as this one.
+ *
+ * No event is serializable unless it opts in, by specializing this. A trivially-copyable event
+ * without pointers or process-local handles can be copied byte-for-byte:
+ *
+ *     template <>
+ *     struct serializer<hologram_input> : trivial_serializer<hologram_input> { };
+ *
+ * Others derive from `fields_serializer`, and list their fields:
+ *
+ *     template <>
+ *     struct serializer<pose_type> : fields_serializer<pose_type> {
+ *         template <typename E>
+ *         static auto fields(E& ev) { return std::tie(ev.sensor_time, ev.position, ev.orientation); }
+ *     };
+ */
+template <typename event, typename Enable = void>
+struct serializer {
+	static constexpr bool enabled = false;
+};
+
+template <typename T>
+struct field_codec<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+	static constexpr std::size_t fixed_size = sizeof(T);
+
+	static std::size_t size(const T&) {
+		return sizeof(T);
+	}
+
+	static void encode(const T& value, char*& out) {
+		std::memcpy(out, &value, sizeof(T));
+		out += sizeof(T);
+	}
+
+	static bool decode(T& value, const char*& in, const char* end) {
+		if (static_cast<std::size_t>(end - in) < sizeof(T)) {
+			return false;
+		}
+		std::memcpy(&value, in, sizeof(T));
+		in += sizeof(T);
+		return true;
+	}
+};
+
+/* A field which is itself a serializable struct. Nested structs must have a fixed size, so that
+   decoding knows where they end. */
+template <typename T>
+struct field_codec<T, std::enable_if_t<!std::is_trivially_copyable_v<T> && serializer<T>::enabled>> {
+	static_assert(serializer<T>::fixed_size() != 0, "A nested struct must have a fixed-size serializer");
+	static constexpr std::size_t fixed_size = serializer<T>::fixed_size();
+
+	static std::size_t size(const T&) {
+		return fixed_size;
+	}
+
+	static void encode(const T& value, char*& out) {
+		serializer<T>::encode(value, out);
+		out += fixed_size;
+	}
+
+	static bool decode(T& value, const char*& in, const char* end) {
+		if (static_cast<std::size_t>(end - in) < fixed_size || !serializer<T>::decode(in, fixed_size, value)) {
+			return false;
+		}
+		in += fixed_size;
+		return true;
+	}
+};
+
+/* A presence flag, then the value. If the value has a fixed size, an absent one is zero-filled,
+   so that the optional has a fixed size too. (Optionals of trivially-copyable types are copied as they are.) */
+template <typename T>
+struct field_codec<std::optional<T>, std::enable_if_t<!std::is_trivially_copyable_v<std::optional<T>>>> {
+	static constexpr std::size_t fixed_size = field_codec<T>::fixed_size == 0 ? 0 : 1 + field_codec<T>::fixed_size;
+
+	static std::size_t size(const std::optional<T>& value) {
+		if constexpr (fixed_size != 0) {
+			return fixed_size;
+		} else {
+			return 1 + (value ? field_codec<T>::size(*value) : 0);
+		}
+	}
+
+	static void encode(const std::optional<T>& value, char*& out) {
+		*out++ = value ? 1 : 0;
+		if (value) {
+			field_codec<T>::encode(*value, out);
+		} else if constexpr (fixed_size != 0) {
+			std::memset(out, 0, field_codec<T>::fixed_size);
+			out += field_codec<T>::fixed_size;
+		}
+	}
+
+	static bool decode(std::optional<T>& value, const char*& in, const char* end) {
+		if (in == end) {
+			return false;
+		}
+		if (*in++) {
+			if (!value) {
+				value.emplace();
+			}
+			return field_codec<T>::decode(*value, in, end);
+		}
+		value.reset();
+		if constexpr (fixed_size != 0) {
+			if (static_cast<std::size_t>(end - in) < field_codec<T>::fixed_size) {
+				return false;
+			}
+			in += field_codec<T>::fixed_size;
+		}
+		return true;
+	}
+};
+
+/* Mixes @p value into the layout hash @p seed. */
+inline std::size_t combine_layout(std::size_t seed, std::size_t value) {
+	return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+/**
+ * @brief Serializes an event byte-for-byte. Only for trivially-copyable events.
+ */
+template <typename event>
+struct trivial_serializer {
+	static_assert(std::is_trivially_copyable_v<event>, "Only trivially-copyable events can be serialized byte-for-byte");
+
+	static constexpr bool enabled = true;
+
+	static constexpr std::size_t fixed_size() {
+		return sizeof(event);
+	}
+
+	static std::size_t layout() {
+		return combine_layout(sizeof(event), alignof(event));
+	}
+
+	static std::size_t size(const event&) {
+		return sizeof(event);
+	}
+
+	static void encode(const event& ev, char* out) {
+		std::memcpy(out, &ev, sizeof(event));
+	}
+
+	static bool decode(const char* in, std::size_t size, event& ev) {
+		if (size != sizeof(event)) {
+			return false;
+		}
+		std::memcpy(&ev, in, sizeof(event));
+		return true;
+	}
+};
+
+/**
+ * @brief Serializes the fields listed by `serializer<event>::fields`, one after another, with no padding or schema.
+ *
+ * The layout is a hash of the fields' types, in order.
+ */
+template <typename event>
+struct fields_serializer {
+private:
+	template <typename Tuple>
+	struct tuple_fixed_size;
+
+	template <typename... Fields>
+	struct tuple_fixed_size<std::tuple<Fields&...>> {
+		static constexpr std::size_t value = ((field_codec<std::remove_const_t<Fields>>::fixed_size != 0) && ...)
+			? (std::size_t{0} + ... + field_codec<std::remove_const_t<Fields>>::fixed_size)
+			: 0;
+	};
+
+	template <typename Tuple>
+	struct tuple_layout;
+
+	template <typename... Fields>
+	struct tuple_layout<std::tuple<Fields&...>> {
+		static std::size_t value() {
+			std::size_t seed = sizeof...(Fields);
+			((seed = combine_layout(seed, typeid(std::remove_const_t<Fields>).hash_code())), ...);
+			return seed;
+		}
+	};
+
+	template <typename Field>
+	using codec = field_codec<std::remove_const_t<std::remove_reference_t<Field>>>;
+
+public:
+	static constexpr bool enabled = true;
+
+	static std::size_t size(const event& ev) {
+		return std::apply([](const auto&... fields) {
+			return (std::size_t{0} + ... + codec<decltype(fields)>::size(fields));
+		}, serializer<event>::fields(ev));
+	}
+
+	static void encode(const event& ev, char* out) {
+		std::apply([&out](const auto&... fields) {
+			(codec<decltype(fields)>::encode(fields, out), ...);
+		}, serializer<event>::fields(ev));
+	}
+
+	static bool decode(const char* in, std::size_t size, event& ev) {
+		const char* const end = in + size;
+		const bool ok = std::apply([&in, end](auto&... fields) {
+			return (codec<decltype(fields)>::decode(fields, in, end) && ...);
+		}, serializer<event>::fields(ev));
+		return ok && in == end;
+	}
+
+	/* A function rather than a constant, since serializer<event>::fields is not declared yet where this class is instantiated. */
+	static constexpr std::size_t fixed_size() {
+		return tuple_fixed_size<decltype(serializer<event>::fields(std::declval<event&>()))>::value;
+	}
+
+	static std::size_t layout() {
+		return tuple_layout<decltype(serializer<event>::fields(std::declval<event&>()))>::value();
+	}
+};
+
+}
@@ -4,28 +4,462 @@
 #include <iostream>
 #include <memory>
 #include <functional>
+#include <cassert>
+#include <type_traits>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
 #include "phonebook.hpp"
+#include "serializer.hpp"
 #include "cpu_timer.hpp"
 
 namespace ILLIXR {
 
+/**
+ * @brief A source of recycled, fixed-size blocks which backs `writer::allocate()`.
+ *
+ * Each topic owns one of these. It is implemented in the runtime, so that plugins need not know
+ * how the blocks are kept.
+ */
+class event_pool {
+public:
+	/**
+	 * @brief Gets a block of at least @p size bytes, aligned to @p align.
+	 */
+	virtual void* allocate(std::size_t size, std::size_t align) = 0;
+
+	/**
+	 * @brief Returns @p block (which came from `allocate(size, align)`) to the pool.
+	 */
+	virtual void deallocate(void* block, std::size_t size, std::size_t align) noexcept = 0;
+
+	virtual ~event_pool() { }
+};
+
+/**
+ * @brief Adapts `event_pool` to the [Allocator][1] concept.
+ *
+ * This lets `std::allocate_shared` place an event and its reference-count in the same recycled
+ * block. The allocator holds the pool by `shared_ptr`, so blocks still in flight when the topic is
+ * destroyed can be safely returned.
+ *
+ * [1]: https://en.cppreference.com/w/cpp/named_req/Allocator
+ */
+template <typename T>
+class event_pool_allocator {
+public:
+	using value_type = T;
+
+	explicit event_pool_allocator(std::shared_ptr<event_pool> pool)
+		: _m_pool{std::move(pool)}
+	{ }
+
+	template <typename U>
+	event_pool_allocator(const event_pool_allocator<U>& other)
+		: _m_pool{other._m_pool}
+	{ }
+
+	T* allocate(std::size_t n) {
+		return static_cast<T*>(_m_pool->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* block, std::size_t n) noexcept {
+		_m_pool->deallocate(block, n * sizeof(T), alignof(T));
+	}
+
+	template <typename U>
+	bool operator==(const event_pool_allocator<U>& other) const { return _m_pool == other._m_pool; }
+
+	template <typename U>
+	bool operator!=(const event_pool_allocator<U>& other) const { return _m_pool != other._m_pool; }
+
+private:
+	template <typename U>
+	friend class event_pool_allocator;
+
+	std::shared_ptr<event_pool> _m_pool;
+};
+
+/**
+ * @brief What switchboard needs to know about an event type once the type is erased.
+ *
+ * One instance per type is built by `event_type::of<event>()`, from the templated methods of
+ * `switchboard`, and handed to the runtime with each topic.
+ */
+struct event_type {
+	/** @brief `typeid(event).hash_code()`, used to check that every user of a topic agrees on its type. */
+	std::size_t hash;
+
+	/** @brief Whether `serializer<event>` is enabled. If not, the encoding members below must not be called. */
+	bool serializable;
+
+	/** @brief The encoded size of every event, or 0 if it varies. */
+	std::size_t fixed_size;
+
+	/** @brief Identifies the encoding (`serializer<event>::layout()`, or 0 if it has none), so that logs and segments of another layout are rejected. */
+	std::size_t layout;
+
+	/** @brief The number of bytes `encode` writes for @p ev. */
+	std::size_t (*encoded_size)(const void* ev);
+
+	/** @brief Writes `encoded_size(ev)` bytes at @p out. */
+	void (*encode)(const void* ev, void* out);
+
+	/**
+	 * @brief Constructs an event in a block from @p pool from @p size encoded bytes, or null if they are malformed.
+	 */
+	std::shared_ptr<void> (*decode)(const void* in, std::size_t size, const std::shared_ptr<event_pool>& pool);
+
+	/**
+	 * @brief Copy-constructs @p ev into a block from @p pool, or null if the type is not copyable.
+	 *
+	 * The returned pointer destroys the event and returns its block to @p pool.
+	 */
+	std::shared_ptr<void> (*copy)(const void* ev, const std::shared_ptr<event_pool>& pool);
+
+	template <typename event>
+	static const event_type& of() {
+		static const event_type type {
+			typeid(event).hash_code(),
+			serializer<event>::enabled,
+			fixed_size_of<event>(),
+			layout_of<event>(),
+			&encoded_size_impl<event>,
+			&encode_impl<event>,
+			&decode_impl<event>,
+			&copy_impl<event>,
+		};
+		return type;
+	}
+
+private:
+	template <typename event>
+	static std::shared_ptr<void> copy_impl(const void* ev, const std::shared_ptr<event_pool>& pool) {
+		if constexpr (std::is_copy_constructible_v<event>) {
+			return std::allocate_shared<event>(event_pool_allocator<event>{pool}, *static_cast<const event*>(ev));
+		} else {
+			return nullptr;
+		}
+	}
+
+	template <typename event>
+	static constexpr std::size_t fixed_size_of() {
+		if constexpr (serializer<event>::enabled) {
+			return serializer<event>::fixed_size();
+		} else {
+			return 0;
+		}
+	}
+
+	template <typename event, typename = void>
+	struct has_layout : std::false_type { };
+
+	template <typename event>
+	struct has_layout<event, std::void_t<decltype(serializer<event>::layout())>> : std::true_type { };
+
+	template <typename event>
+	static std::size_t layout_of() {
+		if constexpr (serializer<event>::enabled && has_layout<event>::value) {
+			return serializer<event>::layout();
+		} else {
+			return 0;
+		}
+	}
+
+	template <typename event>
+	static std::size_t encoded_size_impl(const void* ev) {
+		if constexpr (serializer<event>::enabled) {
+			return serializer<event>::size(*static_cast<const event*>(ev));
+		} else {
+			return 0;
+		}
+	}
+
+	template <typename event>
+	static void encode_impl(const void* ev, void* out) {
+		if constexpr (serializer<event>::enabled) {
+			serializer<event>::encode(*static_cast<const event*>(ev), static_cast<char*>(out));
+		}
+	}
+
+	template <typename event>
+	static std::shared_ptr<void> decode_impl(const void* in, std::size_t size, const std::shared_ptr<event_pool>& pool) {
+		if constexpr (serializer<event>::enabled && std::is_default_constructible_v<event>) {
+			std::shared_ptr<event> ev = std::allocate_shared<event>(event_pool_allocator<event>{pool});
+			if (!serializer<event>::decode(static_cast<const char*>(in), size, *ev)) {
+				return nullptr;
+			}
+			return ev;
+		} else {
+			return nullptr;
+		}
+	}
+};
+
+template <typename event>
+class reader_latest;
+
+/**
+ * @brief The type-erased handle behind `reader_latest`, implemented by the runtime.
+ */
+template <>
+class reader_latest<void> {
+public:
+	virtual std::shared_ptr<const void> get_latest_ro() const = 0;
+
+	virtual std::shared_ptr<void> get_latest() const = 0;
+
+	virtual ~reader_latest() { };
+};
+
 /**
  * @brief A handle which can read the latest event on a topic.
  */
 template <typename event>
 class reader_latest {
 public:
+	explicit reader_latest(std::unique_ptr<reader_latest<void>>&& impl)
+		: _m_impl{std::move(impl)}
+	{ }
+
 	/**
-	 * @brief Gets a "read-only" copy of the latest value.
+	 * @brief Gets a "read-only" reference to the latest value, or null if nothing has been published.
+	 *
+	 * The event stays alive at least as long as the returned pointer (or a copy of it) does, even if
+	 * newer events are published in the meantime.
 	 */
-	virtual const event* get_latest_ro() const = 0;
+	std::shared_ptr<const event> get_latest_ro() const {
+		return std::static_pointer_cast<const event>(_m_impl->get_latest_ro());
+	}
 
 	/**
-	 * @brief Gets a mutable copy of the latest value.
+	 * @brief Gets a mutable copy of the latest value, or null if nothing has been published.
+	 *
+	 * If this is the topic's only subscriber, and nobody else holds the latest event, the event
+	 * itself is handed over instead of a copy. It is then taken out of the topic, so reads
+	 * return null until the next event is published. Either way, nobody else will observe changes
+	 * made through the returned pointer.
+	 *
+	 * @throws if @p event is not copyable and a copy is needed.
 	 */
-	virtual event* get_latest() const = 0;
+	std::shared_ptr<event> get_latest() const {
+		return std::static_pointer_cast<event>(_m_impl->get_latest());
+	}
 
-	virtual ~reader_latest() { };
+private:
+	const std::unique_ptr<reader_latest<void>> _m_impl;
+};
+
+template <typename event>
+class reader;
+
+/**
+ * @brief The type-erased handle behind `reader`, implemented by the runtime.
+ */
+template <>
+class reader<void> {
+public:
+	virtual std::shared_ptr<const void> wait_next(std::chrono::nanoseconds timeout) = 0;
+
+	virtual std::shared_ptr<const void> wait_until(std::uint64_t seq, std::chrono::nanoseconds timeout) = 0;
+
+	virtual std::uint64_t seq() const = 0;
+
+	virtual void notify_next(std::function<void()> callback) = 0;
+
+	virtual ~reader() { };
+};
+
+/**
+ * @brief A handle which can wait for new events on a topic.
+ *
+ * Like `reader_latest`, this only ever sees the latest event; events published while the caller
+ * was busy are skipped (compare `seq()` between calls to count them). Unlike it, the caller
+ * sleeps until an event arrives instead of polling.
+ *
+ * Each handle remembers what it last returned, so it should only be used by one thread.
+ */
+template <typename event>
+class reader {
+public:
+	explicit reader(std::unique_ptr<reader<void>>&& impl)
+		: _m_impl{std::move(impl)}
+	{ }
+
+	/**
+	 * @brief Waits for an event newer than the one this handle last returned, and returns it.
+	 *
+	 * Returns immediately if there already is one. Returns null if @p timeout expires first.
+	 */
+	template <typename Rep, typename Period>
+	std::shared_ptr<const event> wait_next(const std::chrono::duration<Rep, Period>& timeout) {
+		return std::static_pointer_cast<const event>(_m_impl->wait_next(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)));
+	}
+
+	/**
+	 * @brief Waits until at least @p seq events have been published to the topic, and returns the latest.
+	 *
+	 * Returns null if @p timeout expires first.
+	 */
+	template <typename Rep, typename Period>
+	std::shared_ptr<const event> wait_until(std::uint64_t seq, const std::chrono::duration<Rep, Period>& timeout) {
+		return std::static_pointer_cast<const event>(_m_impl->wait_until(seq, std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)));
+	}
+
+	/**
+	 * @brief The sequence number (1 for the topic's first event) of the event last returned, or 0.
+	 */
+	std::uint64_t seq() const {
+		return _m_impl->seq();
+	}
+
+	/**
+	 * @brief Calls @p callback once, when `wait_next` would no longer have to wait.
+	 *
+	 * For callers which cannot block (e.g. tasks on an executor). The callback runs right away if
+	 * there already is a new event, and otherwise on the thread which publishes one, so it should
+	 * be quick (e.g. submit a task which calls `wait_next`). It may occasionally fire without
+	 * `wait_next` then finding a new event, so be ready to call this again.
+	 */
+	void notify_next(std::function<void()> callback) {
+		_m_impl->notify_next(std::move(callback));
+	}
+
+private:
+	const std::unique_ptr<reader<void>> _m_impl;
+};
+
+/**
+ * @brief How to find an event's timestamp, for `switchboard::subscribe_buffered()`.
+ *
+ * Specialize this for each event type which is buffered, with a static `get(const event&)`
+ * returning a `std::chrono::system_clock::time_point`. See data_format.hpp.
+ */
+template <typename event>
+struct event_time;
+
+template <typename event>
+class buffered_reader;
+
+/**
+ * @brief The type-erased handle behind `buffered_reader`, implemented by the runtime.
+ */
+template <>
+class buffered_reader<void> {
+public:
+	using time_point = std::chrono::system_clock::time_point;
+
+	virtual void get_range(time_point begin, time_point end, std::vector<std::shared_ptr<const void>>& out) const = 0;
+
+	virtual void get_last(std::size_t n, std::vector<std::shared_ptr<const void>>& out) const = 0;
+
+	virtual std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>> get_bracket(time_point t) const = 0;
+
+	virtual ~buffered_reader() { };
+};
+
+/**
+ * @brief A handle which can look back over a topic's recent events by timestamp.
+ *
+ * The history lives in the topic, and is shared by every buffered reader of it, so readers do
+ * not keep their own copies. Timestamps come from `event_time<event>`, and are assumed to be
+ * non-decreasing in publication order.
+ *
+ * This is safe to use from any thread.
+ */
+template <typename event>
+class buffered_reader {
+public:
+	using time_point = std::chrono::system_clock::time_point;
+
+	explicit buffered_reader(std::unique_ptr<buffered_reader<void>>&& impl)
+		: _m_impl{std::move(impl)}
+	{ }
+
+	/**
+	 * @brief The buffered events with timestamps in [@p begin, @p end], oldest first.
+	 */
+	std::vector<std::shared_ptr<const event>> get_range(time_point begin, time_point end) const {
+		std::vector<std::shared_ptr<const void>> erased;
+		_m_impl->get_range(begin, end, erased);
+		return cast(std::move(erased));
+	}
+
+	/**
+	 * @brief The latest @p n buffered events (fewer if fewer are buffered), oldest first.
+	 */
+	std::vector<std::shared_ptr<const event>> get_last(std::size_t n) const {
+		std::vector<std::shared_ptr<const void>> erased;
+		_m_impl->get_last(n, erased);
+		return cast(std::move(erased));
+	}
+
+	/**
+	 * @brief The latest event at or before @p t, and the earliest event at or after @p t.
+	 *
+	 * Either is null if @p t is outside the buffered range.
+	 */
+	std::pair<std::shared_ptr<const event>, std::shared_ptr<const event>> get_bracket(time_point t) const {
+		auto bracket = _m_impl->get_bracket(t);
+		return {
+			std::static_pointer_cast<const event>(std::move(bracket.first)),
+			std::static_pointer_cast<const event>(std::move(bracket.second)),
+		};
+	}
+
+	/**
+	 * @brief Estimates the value at @p t from the events around it.
+	 *
+	 * @p interpolate is called as `interpolate(before, after, alpha)`, where `alpha` in [0, 1] is
+	 * how far @p t lies from `before` to `after`, and returns an `event`. Returns nothing if @p t
+	 * is outside the buffered range.
+	 */
+	template <typename Interpolate>
+	std::optional<event> interpolate(time_point t, Interpolate interpolate) const {
+		auto [before, after] = get_bracket(t);
+		if (!before || !after) {
+			return std::nullopt;
+		}
+		const time_point t0 = event_time<event>::get(*before);
+		const time_point t1 = event_time<event>::get(*after);
+		const double alpha = t1 == t0 ? 0.0 : std::chrono::duration<double>(t - t0) / std::chrono::duration<double>(t1 - t0);
+		return interpolate(*before, *after, alpha);
+	}
+
+private:
+	static std::vector<std::shared_ptr<const event>> cast(std::vector<std::shared_ptr<const void>>&& erased) {
+		std::vector<std::shared_ptr<const event>> events;
+		events.reserve(erased.size());
+		for (auto& ev : erased) {
+			events.push_back(std::static_pointer_cast<const event>(std::move(ev)));
+		}
+		return events;
+	}
+
+	const std::unique_ptr<buffered_reader<void>> _m_impl;
+};
+
+template <typename event>
+class writer;
+
+/**
+ * @brief The type-erased handle behind `writer`, implemented by the runtime.
+ */
+template <>
+class writer<void> {
+public:
+	virtual void put(std::shared_ptr<const void>&& ev) = 0;
+
+	/** Publishes @p count events, oldest first, moving from each. */
+	virtual void put_bulk(std::shared_ptr<const void>* events, std::size_t count) = 0;
+
+	virtual std::shared_ptr<event_pool> get_pool() const = 0;
+
+	virtual ~writer() { };
 };
 
 /**
@@ -34,27 +468,242 @@ public:
 template <typename event>
 class writer {
 public:
+	explicit writer(std::unique_ptr<writer<void>>&& impl)
+		: _m_alloc{impl->get_pool()}
+		, _m_impl{std::move(impl)}
+	{ }
+
 	/**
 	 * @brief Publish @p ev to this topic.
 	 *
-	 * Currently, nobody is responsible for calling `delete` on it, but this will change.
+	 * Switchboard releases its references once the event is no longer the latest and every
+	 * scheduled callback has seen it. Events from `allocate()` then go back to the topic's pool.
+	 */
+	void put(std::shared_ptr<const event> ev) {
+		assert(ev);
+		_m_impl->put(std::move(ev));
+	}
+
+	/**
+	 * @brief Publish @p ev, which must come from `new`, to this topic.
+	 *
+	 * Switchboard takes ownership and calls `delete` on it once nobody is using it. The caller must
+	 * not touch it after this. Prefer `allocate()`, which avoids the heap allocation.
+	 */
+	void put(const event* ev) {
+		assert(ev);
+		_m_impl->put(std::shared_ptr<const event>{ev});
+	}
+
+	/**
+	 * @brief Publish the events in [@p first, @p last), oldest first, as if by `put()` on each.
+	 *
+	 * Each scheduled callback's queue is locked, and its worker woken, once per batch rather than
+	 * once per event. Use this for high-rate sensors (e.g. IMUs) which deliver samples in bursts.
+	 * The iterators must yield `std::shared_ptr<event>` or `std::shared_ptr<const event>`.
 	 */
-	virtual void put(const event* ev) = 0;
+	template <typename Iterator>
+	void put_bulk(Iterator first, Iterator last) {
+		/* Type-erased in chunks on the stack, so this does not allocate. */
+		std::array<std::shared_ptr<const void>, BULK_CHUNK> chunk;
+		std::size_t size = 0;
+		for (; first != last; ++first) {
+			assert(*first);
+			chunk[size++] = std::shared_ptr<const event>{*first};
+			if (size == chunk.size()) {
+				_m_impl->put_bulk(chunk.data(), size);
+				size = 0;
+			}
+		}
+		if (size > 0) {
+			_m_impl->put_bulk(chunk.data(), size);
+		}
+	}
+
+	void put_bulk(const std::vector<std::shared_ptr<event>>& events) {
+		put_bulk(events.begin(), events.end());
+	}
 
 	/**
 	 * @brief Like `new`/`malloc` but more efficient for the specific case.
-	 * 
-	 * There is an optimization available which has not yet been implemented: switchboard can memory
-	 * from old events, like a [slab allocator][1]. Suppose module A publishes data for module
-	 * B. B's deallocation through the destructor, and A's allocation through this method completes
-	 * the cycle in a [double-buffer (AKA swap-chain)][2].
+	 *
+	 * Switchboard recycles memory from old events, like a [slab allocator][1]. Suppose module A
+	 * publishes data for module B. B's release of the event, and A's allocation through this
+	 * method completes the cycle in a [double-buffer (AKA swap-chain)][2].
+	 *
+	 * The event is value-initialized; fill it in and then `put()` it.
 	 *
 	 * [1]: https://en.wikipedia.org/wiki/Slab_allocation
 	 * [2]: https://en.wikipedia.org/wiki/Multiple_buffering
 	 */
-	virtual event* allocate() = 0;
+	std::shared_ptr<event> allocate() {
+		return std::allocate_shared<event>(_m_alloc);
+	}
 
-	virtual ~writer() { };
+private:
+	static constexpr std::size_t BULK_CHUNK = 64;
+
+	event_pool_allocator<event> _m_alloc;
+	const std::unique_ptr<writer<void>> _m_impl;
+};
+
+/**
+ * @brief What `put()` does when a scheduled callback's queue is full.
+ */
+enum class overflow_policy {
+	/**
+	 * Wait until the callback catches up. Nothing is lost, but a slow callback slows the writer.
+	 * A callback must not publish to a topic which it (transitively) blocks on. With the shared
+	 * executor (see common/executor.hpp), a callback or task which blocks here holds a worker, so
+	 * topics written from them should drop instead.
+	 */
+	block,
+	/** Discard the oldest queued event to make room. Use this when only the freshest events matter. */
+	drop_oldest,
+	/** Discard the event being published. */
+	drop_newest,
+};
+
+/**
+ * @brief Which scheduled callbacks a switchboard worker serves first.
+ */
+enum class priority_class {
+	/**
+	 * Latency-critical, e.g. the pose path. Served before everything else, and by dedicated
+	 * workers if `ILLIXR_SWITCHBOARD_RT_THREADS` is set (see switchboard_impl.hpp).
+	 */
+	realtime,
+	normal,
+	/**
+	 * Only served when nothing else is waiting, e.g. visualization. So under load its queue
+	 * fills up; pair it with a dropping overflow_policy, lest it block the writer.
+	 */
+	background,
+};
+
+/**
+ * @brief Bounds the queue between a topic and one scheduled callback, and sets its priority.
+ *
+ * For example, `{2, overflow_policy::drop_oldest}` keeps only the latest 2 events.
+ */
+struct queue_policy {
+	std::size_t capacity = 256;
+	overflow_policy overflow = overflow_policy::block;
+	priority_class priority = priority_class::normal;
+};
+
+/**
+ * @brief A snapshot of one topic, from `switchboard::get_topic_stats()`.
+ *
+ * Counts over scheduled callbacks are summed over every callback on the topic.
+ */
+struct topic_stats {
+	static constexpr std::size_t LATENCY_BUCKETS = 24;
+
+	std::string name;
+	std::size_t type_hash;
+
+	std::size_t writers;
+	/** `reader_latest`, `reader`, and `buffered_reader` handles. */
+	std::size_t readers;
+	std::size_t callbacks;
+
+	std::uint64_t published;
+	/** Events per second over the last second or two, as measured by the publisher. Reading it has no side effects. */
+	double publish_rate;
+
+	/** Events waiting for a callback right now. */
+	std::size_t queue_depth;
+	std::size_t processed;
+	std::size_t unprocessed;
+	std::size_t dropped_oldest;
+	std::size_t dropped_newest;
+
+	/**
+	 * Time from publication to the callback's return. Bucket i counts deliveries which took
+	 * [2^i, 2^(i+1)) microseconds; the first and last buckets also count anything faster and
+	 * slower, respectively.
+	 */
+	std::array<std::size_t, LATENCY_BUCKETS> callback_latency_us;
+};
+
+/**
+ * @brief The events passed to a `switchboard::schedule_batch()` callback, oldest first.
+ *
+ * Like the raw pointer passed by `schedule()`, the events are only valid for the duration of the
+ * call. Use `share()` to keep one.
+ */
+template <typename event>
+class event_batch {
+public:
+	class iterator {
+	public:
+		explicit iterator(const std::shared_ptr<const void>* pos)
+			: _m_pos{pos}
+		{ }
+
+		const event& operator*() const {
+			return *static_cast<const event*>(_m_pos->get());
+		}
+
+		const event* operator->() const {
+			return static_cast<const event*>(_m_pos->get());
+		}
+
+		iterator& operator++() {
+			++_m_pos;
+			return *this;
+		}
+
+		bool operator==(const iterator& other) const {
+			return _m_pos == other._m_pos;
+		}
+
+		bool operator!=(const iterator& other) const {
+			return _m_pos != other._m_pos;
+		}
+
+	private:
+		const std::shared_ptr<const void>* _m_pos;
+	};
+
+	event_batch(const std::shared_ptr<const void>* events, std::size_t size)
+		: _m_events{events}
+		, _m_size{size}
+	{ }
+
+	std::size_t size() const {
+		return _m_size;
+	}
+
+	const event& operator[](std::size_t i) const {
+		assert(i < _m_size);
+		return *static_cast<const event*>(_m_events[i].get());
+	}
+
+	const event& back() const {
+		return (*this)[_m_size - 1];
+	}
+
+	/**
+	 * @brief Shares ownership of event @p i, so it can be kept after the callback returns.
+	 */
+	std::shared_ptr<const event> share(std::size_t i) const {
+		assert(i < _m_size);
+		return std::static_pointer_cast<const event>(_m_events[i]);
+	}
+
+	iterator begin() const {
+		return iterator{_m_events};
+	}
+
+	iterator end() const {
+		return iterator{_m_events + _m_size};
+	}
+
+private:
+	const std::shared_ptr<const void>* const _m_events;
+	const std::size_t _m_size;
 };
 
 /* This class is pure virtual so that I can hide its implementation from its users. It will be
@@ -63,6 +712,10 @@ public:
    However, virtual methods cannot be templated, so these templated methods refer to a virtual
    method whose type has been erased (coerced to/from void*). This is an instance of the Non-Virtual
    Interface pattern: https://en.wikibooks.org/wiki/More_C%2B%2B_Idioms/Non-Virtual_Interface
+
+   The handles follow the same pattern: `writer<void>` and `reader_latest<void>` are the erased
+   interfaces which the runtime implements, and `writer<event>` and `reader_latest<event>` are thin
+   typed wrappers around them, compiled into the plugin.
 */
 
 /**
@@ -76,6 +729,8 @@ public:
  *   - Asynchronous reading returns the most-recent event on the topic (idempotently). One can do
  *     this through (in any thread) the `ILLIXR::reader_latest` handle returned by
  *     `subscribe_latest()`.
+ *     To sleep until the next event instead of polling, use the `ILLIXR::reader` handle returned
+ *     by `subscribe()`.
  *
  *   - Synchronous reading schedules a callback to be executed on _every_ event which gets
  *     published. One can schedule computation by `schedule()`, which will run the computation in a
@@ -87,7 +742,7 @@ public:
  *     auto topic2 = sb->publish<topic2_type>("topic2");
  * 
  *     // Read topic 3 synchronously
- *     sb->schedule<topic3_type>("topic3", [&](const topic3_type *event3) {
+ *     sb->schedule<topic3_type>(id, "topic3", [&](const topic3_type *event3) {
  *         // This is a lambda expression
  *         // https://en.cppreference.com/w/cpp/language/lambda
  *         std::cout << "Got a new event on topic3: " << event3 << std::endl;
@@ -95,11 +750,11 @@ public:
  *
  *     while (true) {
  *         // Read topic 1
- *         topic1_type* event1 = topic1.get_latest_ro();
+ *         std::shared_ptr<const topic1_type> event1 = topic1->get_latest_ro();
  *
  *         // Write to topic 2
- *         topic2_type* event2 = new topic2_type;
- *         topic2.put(event2);
+ *         std::shared_ptr<topic2_type> event2 = topic2->allocate();
+ *         topic2->put(event2);
  *     }
  * }
  * \endcode
@@ -109,13 +764,25 @@ class switchboard : public phonebook::service {
 
 private:
 	virtual
-	std::unique_ptr<writer<void>> _p_publish(const std::string& topic_name, std::size_t ty) = 0;
+	std::unique_ptr<writer<void>> _p_publish(const std::string& topic_name, const event_type& type) = 0;
+
+	virtual
+	std::unique_ptr<reader_latest<void>> _p_subscribe_latest(const std::string& topic_name, const event_type& type) = 0;
+
+	virtual
+	std::unique_ptr<reader<void>> _p_subscribe(const std::string& topic_name, const event_type& type) = 0;
+
+	virtual
+	std::unique_ptr<buffered_reader<void>> _p_subscribe_buffered(const std::string& topic_name, const event_type& type, std::size_t capacity, std::chrono::nanoseconds max_age, std::chrono::system_clock::time_point (*time_of)(const void*)) = 0;
+
+	virtual
+	void _p_schedule(std::size_t component_id, const std::string& topic_name, std::function<void(const std::shared_ptr<const void>&)> fn, const event_type& type, queue_policy policy) = 0;
 
 	virtual
-	std::unique_ptr<reader_latest<void>> _p_subscribe_latest(const std::string& topic_name, std::size_t ty) = 0;
+	void _p_schedule_batch(std::size_t component_id, const std::string& topic_name, std::function<void(const std::shared_ptr<const void>*, std::size_t)> fn, const event_type& type, std::size_t max_batch, queue_policy policy) = 0;
 
 	virtual
-	void _p_schedule(std::size_t component_id, const std::string& topic_name, std::function<void(const void*)> fn, std::size_t ty) = 0;
+	void _p_unschedule(std::size_t component_id, const std::string& topic_name) = 0;
 
 	/* TODO: (usability) add a method which queries if a topic has a writer. Readers might assert this. */
 
@@ -124,19 +791,65 @@ public:
 	/**
 	 * @brief Schedules the callback @p fn every time an event is published to @p topic_name.
 	 *
-	 * Switchboard maintains a threadpool to call @p fn. It is possible
-	 * multiple instances of @p fn will be running concurrently if the
-	 * event's repetition period is less than the runtime of @p fn.
+	 * Switchboard maintains a threadpool to call @p fn. Calls to one @p fn are made one at a
+	 * time, in publication order, but different callbacks may run concurrently.
 	 *
-	 * This is safe to be called from any thread.
+	 * Events wait for @p fn in a queue of their own, bounded according to @p policy, so a slow
+	 * callback cannot hold up other subscribers or grow without bound.
+	 *
+	 * This is safe to be called from any thread, at any time. @p fn itself may publish, schedule,
+	 * and unschedule (but see `overflow_policy::block`).
+	 *
+	 * @throws if topic already exists, and its type does not match the @p event.
+	 */
+	template <typename event>
+	void schedule(std::size_t component_id, const std::string& topic_name, std::function<void(const event*)> fn, queue_policy policy = {}) {
+		_p_schedule(component_id, topic_name, [=](const std::shared_ptr<const void>& ptr) {
+			fn(static_cast<const event*>(ptr.get()));
+		}, event_type::of<event>(), policy);
+	}
+
+	/**
+	 * @brief Like `schedule()`, but @p fn shares ownership of the event.
+	 *
+	 * Use this if @p fn keeps the event after it returns. The raw pointer passed by the other
+	 * overload is only valid for the duration of the call.
+	 */
+	template <typename event>
+	void schedule(std::size_t component_id, const std::string& topic_name, std::function<void(std::shared_ptr<const event>)> fn, queue_policy policy = {}) {
+		_p_schedule(component_id, topic_name, [=](const std::shared_ptr<const void>& ptr) {
+			fn(std::static_pointer_cast<const event>(ptr));
+		}, event_type::of<event>(), policy);
+	}
+
+	/**
+	 * @brief Like `schedule()`, but @p fn gets every event which queued up since its last call, up
+	 * to @p max_batch at a time.
+	 *
+	 * Batches are delivered in publication order, one at a time. A batch is whatever is waiting
+	 * when a worker gets to it, so its size varies from 1 to @p max_batch. This saves a dispatch
+	 * per event on high-rate topics whose consumers process samples in groups anyway (e.g. IMU
+	 * integration). @p policy bounds the queue in events, as for `schedule()`.
 	 *
 	 * @throws if topic already exists, and its type does not match the @p event.
 	 */
 	template <typename event>
-	void schedule(std::size_t component_id, const std::string& topic_name, std::function<void(const event*)> fn) {
-		_p_schedule(component_id, topic_name, [=](const void* ptr) {
-			fn(reinterpret_cast<const event*>(ptr));
-		}, typeid(event).hash_code());
+	void schedule_batch(std::size_t component_id, const std::string& topic_name, std::function<void(const event_batch<event>&)> fn, std::size_t max_batch = 64, queue_policy policy = {}) {
+		_p_schedule_batch(component_id, topic_name, [=](const std::shared_ptr<const void>* events, std::size_t size) {
+			fn(event_batch<event>{events, size});
+		}, event_type::of<event>(), max_batch, policy);
+	}
+
+	/**
+	 * @brief Stops calling every callback which @p component_id scheduled on @p topic_name.
+	 *
+	 * Events already queued for those callbacks are discarded. A callback which is running
+	 * when this is called may still finish, but none will start afterwards.
+	 *
+	 * This is safe to be called from any thread, including from a callback.
+	 */
+	void unschedule(std::size_t component_id, const std::string& topic_name) {
+		_p_unschedule(component_id, topic_name);
 	}
 
 	/**
@@ -148,8 +861,7 @@ public:
 	 */
 	template <typename event>
 	std::unique_ptr<writer<event>> publish(const std::string& topic_name) {
-		auto void_writer = _p_publish(topic_name, typeid(event).hash_code());
-		return std::move(std::unique_ptr<writer<event>>(reinterpret_cast<writer<event>*>(void_writer.release())));
+		return std::make_unique<writer<event>>(_p_publish(topic_name, event_type::of<event>()));
 	}
 
 	/**
@@ -161,10 +873,50 @@ public:
 	 */
 	template <typename event>
 	std::unique_ptr<reader_latest<event>> subscribe_latest(const std::string& topic_name) {
-		auto void_writer = _p_subscribe_latest(topic_name, typeid(event).hash_code());
-		return std::move(std::unique_ptr<reader_latest<event>>(reinterpret_cast<reader_latest<event>*>(void_writer.release())));
+		return std::make_unique<reader_latest<event>>(_p_subscribe_latest(topic_name, event_type::of<event>()));
+	}
+
+	/**
+	 * @brief Gets a handle to wait for new values on the topic @p topic_name.
+	 *
+	 * Prefer this to polling `subscribe_latest()` in a loop: the caller wakes as soon as an event
+	 * is published.
+	 *
+	 * This is safe to be called from any thread.
+	 *
+	 * @throws If topic already exists, and its type does not match the @p event.
+	 */
+	template <typename event>
+	std::unique_ptr<reader<event>> subscribe(const std::string& topic_name) {
+		return std::make_unique<reader<event>>(_p_subscribe(topic_name, event_type::of<event>()));
+	}
+
+	/**
+	 * @brief Gets a handle to look back over recent events on the topic @p topic_name.
+	 *
+	 * The topic keeps its last @p capacity events, and drops those more than @p max_age older
+	 * than the newest. If several buffered readers ask for different bounds, the topic keeps
+	 * enough for all of them. `event_time<event>` must be specialized.
+	 *
+	 * This is safe to be called from any thread. Events published before the first buffered
+	 * reader is created are not buffered.
+	 *
+	 * @throws If topic already exists, and its type does not match the @p event.
+	 */
+	template <typename event>
+	std::unique_ptr<buffered_reader<event>> subscribe_buffered(const std::string& topic_name, std::size_t capacity, std::chrono::nanoseconds max_age = std::chrono::nanoseconds::max()) {
+		return std::make_unique<buffered_reader<event>>(_p_subscribe_buffered(topic_name, event_type::of<event>(), capacity, max_age, [](const void* ev) {
+			return event_time<event>::get(*static_cast<const event*>(ev));
+		}));
 	}
 
+	/**
+	 * @brief A snapshot of every topic, for monitoring where the pipeline backs up.
+	 *
+	 * This is safe to be called from any thread, and does not slow down publishers.
+	 */
+	virtual std::vector<topic_stats> get_topic_stats() = 0;
+
 	virtual ~switchboard() { }
 
 	virtual void stop() = 0;
@@ -0,0 +1,73 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "../executor.hpp"
+
+namespace ILLIXR {
+
+template <typename Predicate>
+static bool eventually(Predicate pred) {
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+	while (!pred()) {
+		if (std::chrono::steady_clock::now() > deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	return true;
+}
+
+TEST(Executor, RunsTasksAndTimers) {
+	executor exec {3};
+	std::atomic<std::size_t> ran {0};
+	std::atomic<std::size_t> continuations {0};
+	for (std::size_t i = 0; i < 1000; ++i) {
+		exec.submit([i, &ran, &continuations, &exec]() {
+			ran++;
+			// Tasks submitted from a worker go to its own deque, and may be stolen from there.
+			if (i % 10 == 0) {
+				exec.submit([&continuations]() { continuations++; });
+			}
+		});
+	}
+	ASSERT_TRUE(eventually([&] { return ran.load() == 1000 && continuations.load() == 100; }));
+
+	const auto target = std::chrono::steady_clock::now() + std::chrono::milliseconds{20};
+	std::atomic<bool> fired {false};
+	exec.submit_at(target, [&]() {
+		EXPECT_GE(std::chrono::steady_clock::now(), target);
+		fired = true;
+	});
+	ASSERT_TRUE(eventually([&] { return fired.load(); }));
+	exec.stop();
+}
+
+TEST(Executor, ResubmittingTaskDoesNotStarveOlderOnes) {
+	std::atomic<bool> stopping {false};
+	std::atomic<bool> older_ran {false};
+	std::atomic<bool> external_ran {false};
+	executor exec {1};
+
+	// Like a threadloop's step: resubmits itself onto the back of its worker's deque, forever.
+	std::function<void()> spin = [&]() {
+		if (!stopping) {
+			exec.submit(spin);
+		}
+	};
+	exec.submit([&]() {
+		// Queued in front of the spinning task, in the same deque.
+		exec.submit([&]() { older_ran = true; });
+		spin();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds{10});
+	exec.submit([&]() { external_ran = true; });
+
+	EXPECT_TRUE(eventually([&] { return older_ran.load() && external_ran.load(); }));
+	stopping = true;
+	exec.stop();
+}
+
+}
@@ -0,0 +1,46 @@
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "../perf_counters.hpp"
+
+namespace ILLIXR {
+
+TEST(PerfCounters, CountOnlyWhenEnabled) {
+	const auto busy_sample = []() {
+		perf_counters::sample counted;
+		// Counters belong to the thread which opens them.
+		std::thread{[&counted]() {
+			const perf_counters& counters = perf_counters::this_thread();
+			const perf_counters::sample start = counters.read();
+			volatile double sum = 0;
+			for (std::size_t i = 0; i < 1000000; ++i) {
+				sum = sum + double(i);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+			counted = counters.read() - start;
+		}}.join();
+		return counted;
+	};
+
+	const perf_counters::sample off = busy_sample();
+	EXPECT_EQ(off.cycles, 0);
+	EXPECT_EQ(off.instructions, 0);
+	EXPECT_EQ(off.context_switches, 0);
+
+	setenv("ILLIXR_PERF_COUNTERS", "y", true);
+	const perf_counters::sample on = busy_sample();
+	unsetenv("ILLIXR_PERF_COUNTERS");
+	if (on.instructions == 0 && on.context_switches == 0) {
+		GTEST_SKIP() << "perf_event_open is not permitted here";
+	}
+	if (on.instructions > 0) {
+		EXPECT_GT(on.instructions, 1000000);
+		EXPECT_GT(on.cycles, 0);
+	}
+	// The sleep switched out at least once.
+	EXPECT_GE(on.context_switches, 1);
+}
+
+}
@@ -0,0 +1,31 @@
+#include <chrono>
+#include <memory>
+#include <gtest/gtest.h>
+
+#include "../precise_sleep.hpp"
+
+namespace ILLIXR {
+
+class discard_record_logger : public record_logger {
+public:
+	virtual void log(const record& r) override {
+		r.mark_used();
+	}
+};
+
+TEST(PreciseSleeper, NeverWakesEarly) {
+	precise_sleeper sleeper {"test", std::make_shared<discard_record_logger>()};
+	for (std::size_t i = 0; i < 20; ++i) {
+		const auto target = std::chrono::steady_clock::now() + std::chrono::milliseconds{2};
+		const std::chrono::nanoseconds overshoot = sleeper.sleep_until(target);
+		ASSERT_GE(std::chrono::steady_clock::now(), target);
+		ASSERT_GE(overshoot.count(), 0);
+	}
+	// Calibrated within its bounds.
+	ASSERT_GE(sleeper.spin_margin(), std::chrono::microseconds{20});
+	ASSERT_LE(sleeper.spin_margin(), std::chrono::milliseconds{2});
+	// A deadline in the past, or on another clock, returns right away.
+	ASSERT_EQ(sleeper.sleep_until(std::chrono::system_clock::now() - std::chrono::seconds{1}).count(), 0);
+}
+
+}
@@ -0,0 +1,54 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../record_logger.hpp"
+
+namespace ILLIXR {
+
+class batch_record_logger : public record_logger {
+public:
+	virtual void log(const record& r) override {
+		r.mark_used();
+		records.push_back(r.get_value<std::string>(1));
+	}
+
+	virtual void log(std::unique_ptr<const record_batch> batch) override {
+		batch_sizes.push_back(batch->size());
+		record_logger::log(std::move(batch));
+	}
+
+	std::vector<std::size_t> batch_sizes;
+	std::vector<std::string> records;
+};
+
+const record_header __typed_test_header {"typed_test", {
+	{"id", typeid(std::size_t)},
+	{"name", typeid(std::string)},
+	{"skipped", typeid(bool)},
+}};
+
+TEST(TypedRecordCoalescer, FlushesFullBatchesInColumns) {
+	auto logger = std::make_shared<batch_record_logger>();
+	{
+		typed_record_coalescer<std::size_t, std::string, bool> log {logger, __typed_test_header, 4};
+		for (std::size_t i = 0; i < 6; ++i) {
+			log.log(i, std::to_string(i), i % 2 == 0);
+		}
+		// The first 4 rows filled the batch, so they were handed over as one.
+		ASSERT_EQ(logger->batch_sizes, (std::vector<std::size_t>{4}));
+	}
+	// The rest are flushed on destruction.
+	ASSERT_EQ(logger->batch_sizes, (std::vector<std::size_t>{4, 2}));
+	ASSERT_EQ(logger->records, (std::vector<std::string>{"0", "1", "2", "3", "4", "5"}));
+
+	typed_record_batch<std::size_t, std::string, bool> batch {__typed_test_header, 2};
+	batch.push(7, "seven", true);
+	ASSERT_EQ(batch.get_value<std::size_t>(0, 0), 7);
+	ASSERT_EQ(batch.get_value<std::string>(0, 1), "seven");
+	ASSERT_TRUE(static_cast<const bool*>(batch.column_data(2))[0]);
+	ASSERT_FALSE(batch.full());
+}
+
+}
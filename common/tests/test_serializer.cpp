@@ -0,0 +1,121 @@
+#include <new>
+#include <gtest/gtest.h>
+
+#include "../data_format.hpp"
+
+namespace ILLIXR {
+
+/* Hands out blocks from the heap, since the runtime's slab_pool is not available here. */
+class heap_pool : public event_pool {
+public:
+	virtual void* allocate(std::size_t size, std::size_t align) override {
+		return ::operator new(size, std::align_val_t{align});
+	}
+
+	virtual void deallocate(void* block, std::size_t, std::size_t align) noexcept override {
+		::operator delete(block, std::align_val_t{align});
+	}
+};
+
+typedef struct {
+	std::size_t seq;
+	double payload[8];
+} plain_event;
+
+typedef struct {
+	std::size_t seq;
+	double payload[8];
+} opted_in_event;
+
+template <>
+struct serializer<opted_in_event> : trivial_serializer<opted_in_event> { };
+
+TEST(Serializer, RoundTripsFieldsOfDataFormatTypes) {
+	const event_type& type = event_type::of<fast_pose_type>();
+	ASSERT_TRUE(type.serializable);
+	// pose_type: time, 3 floats, 4 floats; then two more times.
+	ASSERT_EQ(type.fixed_size, 3 * sizeof(time_type) + 7 * sizeof(float));
+
+	fast_pose_type pose;
+	pose.pose.sensor_time = time_type{std::chrono::seconds{3}};
+	pose.pose.position = Eigen::Vector3f{1, 2, 3};
+	pose.pose.orientation = Eigen::Quaternionf{0.5, 0.5, 0.5, 0.5};
+	pose.predict_computed_time = time_type{std::chrono::seconds{4}};
+	pose.predict_target_time = time_type{std::chrono::seconds{5}};
+
+	std::vector<char> buffer (type.encoded_size(&pose));
+	type.encode(&pose, buffer.data());
+	auto pool = std::make_shared<heap_pool>();
+	std::shared_ptr<void> decoded = type.decode(buffer.data(), buffer.size(), pool);
+	ASSERT_NE(decoded, nullptr);
+	const fast_pose_type& copy = *static_cast<const fast_pose_type*>(decoded.get());
+	EXPECT_EQ(copy.pose.sensor_time, pose.pose.sensor_time);
+	EXPECT_EQ(copy.pose.position, pose.pose.position);
+	EXPECT_EQ(copy.pose.orientation.coeffs(), pose.pose.orientation.coeffs());
+	EXPECT_EQ(copy.predict_target_time, pose.predict_target_time);
+
+	// Truncated input does not decode.
+	EXPECT_EQ(type.decode(buffer.data(), buffer.size() - 1, pool), nullptr);
+}
+
+TEST(Serializer, ImagesRoundTripAndRejectBadHeaders) {
+	cv::Mat image {2, 3, CV_MAKETYPE(CV_8U, 3)};
+	for (int row = 0; row < image.rows; ++row) {
+		for (std::size_t i = 0; i < 3 * 3; ++i) {
+			image.ptr(row)[i] = static_cast<unsigned char>(row * 10 + i);
+		}
+	}
+	std::vector<char> buffer (field_codec<cv::Mat>::size(image));
+	ASSERT_EQ(buffer.size(), 3 * sizeof(std::int32_t) + 2 * 3 * 3);
+	char* out = buffer.data();
+	field_codec<cv::Mat>::encode(image, out);
+
+	cv::Mat copy;
+	const char* in = buffer.data();
+	ASSERT_TRUE(field_codec<cv::Mat>::decode(copy, in, buffer.data() + buffer.size()));
+	EXPECT_EQ(in, buffer.data() + buffer.size());
+	EXPECT_EQ(copy.type(), image.type());
+	EXPECT_EQ(std::memcmp(copy.ptr(1), image.ptr(1), 3 * 3), 0);
+
+	auto decodes = [](std::int32_t rows, std::int32_t cols, std::int32_t type) {
+		std::vector<char> bytes (3 * sizeof(std::int32_t) + 64);
+		const std::int32_t header[3] = {rows, cols, type};
+		std::memcpy(bytes.data(), header, sizeof(header));
+		cv::Mat value;
+		const char* in = bytes.data();
+		return field_codec<cv::Mat>::decode(value, in, bytes.data() + bytes.size());
+	};
+	EXPECT_TRUE(decodes(4, 4, CV_MAKETYPE(CV_32F, 1)));
+	// More pixels than bytes, even where rows * cols * elemSize overflows an int.
+	EXPECT_FALSE(decodes(5, 4, CV_MAKETYPE(CV_32F, 1)));
+	EXPECT_FALSE(decodes(1 << 30, 1 << 30, CV_MAKETYPE(CV_64F, 4)));
+	// Not a type at all: an unknown depth, or bits beyond the channel count.
+	EXPECT_FALSE(decodes(1, 1, CV_64F + 1));
+	EXPECT_FALSE(decodes(1, 1, 1 << 20));
+	EXPECT_FALSE(decodes(1, 1, -1));
+}
+
+TEST(Serializer, OnlyOptedInTypesAreSerializable) {
+	// Not even trivially-copyable events, unless they opt in.
+	EXPECT_FALSE(event_type::of<plain_event>().serializable);
+	EXPECT_TRUE(event_type::of<opted_in_event>().serializable);
+	EXPECT_EQ(event_type::of<opted_in_event>().fixed_size, sizeof(opted_in_event));
+	// Others list their fields. Images vary in size.
+	EXPECT_TRUE(event_type::of<imu_cam_type>().serializable);
+	EXPECT_EQ(event_type::of<imu_cam_type>().fixed_size, 0);
+	EXPECT_FALSE(event_type::of<std::string>().serializable);
+	// Pointers and GL handles do not survive serialization, so these do not opt in.
+	EXPECT_FALSE(event_type::of<rgb_depth_type>().serializable);
+	EXPECT_FALSE(event_type::of<rendered_frame>().serializable);
+}
+
+TEST(Serializer, LayoutsTellEncodingsApart) {
+	EXPECT_NE(event_type::of<opted_in_event>().layout, 0);
+	EXPECT_NE(event_type::of<pose_type>().layout, 0);
+	// Different fields, or the same fields in another order, make another layout.
+	EXPECT_NE(event_type::of<pose_type>().layout, event_type::of<fast_pose_type>().layout);
+	EXPECT_NE(event_type::of<imu_raw_type>().layout, event_type::of<imu_integrator_input>().layout);
+	EXPECT_EQ(event_type::of<pose_type>().layout, event_type::of<pose_type>().layout);
+}
+
+}
@@ -0,0 +1,41 @@
+#include <cstdlib>
+#include <pthread.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "../thread_config.hpp"
+
+namespace ILLIXR {
+
+TEST(ThreadConfig, ParsesEnvironment) {
+	setenv("ILLIXR_THREAD_CPUS_test_plugin", "0,2-4", 1);
+	setenv("ILLIXR_THREAD_SCHED_test_plugin", "other:5", 1);
+	const thread_config config = thread_config::from_env("test_plugin");
+	EXPECT_EQ(config.cpus, (std::vector<int>{0, 2, 3, 4}));
+	EXPECT_FALSE(config.fifo_priority);
+	EXPECT_EQ(config.nice, 5);
+
+	setenv("ILLIXR_THREAD_SCHED_test_plugin", "fifo:80", 1);
+	EXPECT_EQ(thread_config::from_env("test_plugin").fifo_priority, 80);
+
+	setenv("ILLIXR_THREAD_SCHED_test_plugin", "deadline", 1);
+	EXPECT_THROW(thread_config::from_env("test_plugin"), std::runtime_error);
+	unsetenv("ILLIXR_THREAD_CPUS_test_plugin");
+	unsetenv("ILLIXR_THREAD_SCHED_test_plugin");
+}
+
+TEST(ThreadConfig, NamesThread) {
+	std::string name;
+	std::thread{[&name]() {
+		thread_config{}.apply("a_rather_long_thread_name");
+		char buffer[16];
+		pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+		name = buffer;
+	}}.join();
+	EXPECT_EQ(name, "a_rather_long_t");
+}
+
+}
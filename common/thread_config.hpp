@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ILLIXR {
+
+/**
+ * @brief Names the calling thread, so that it shows up in top, perf, and gdb.
+ *
+ * The kernel keeps at most 15 characters, so longer names are truncated.
+ */
+inline void set_thread_name(const std::string& name) {
+	pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+}
+
+/**
+ * @brief Where and how one of ILLIXR's threads is scheduled.
+ *
+ * Read from the environment (the runner sets these from a config's `threads` section), keyed by
+ * the thread's role:
+ * - `ILLIXR_THREAD_CPUS_<key>`: the CPUs it may run on, e.g. `2,4-5`.
+ * - `ILLIXR_THREAD_SCHED_<key>`: `fifo:<priority>` for SCHED_FIFO (1-99; needs CAP_SYS_NICE or an
+ *   rtprio limit), or `other:<nice>` for SCHED_OTHER at that nice value.
+ *
+ * The key is a threadloop plugin's name (e.g. `timewarp_gl`), `switchboard` for switchboard's
+ * workers, `switchboard_rt` for its realtime workers, or `sqlite` for the record logger's threads.
+ * Unconfigured threads keep the default policy, and whatever affinity they inherited.
+ */
+struct thread_config {
+	std::vector<int> cpus;
+	std::optional<int> fifo_priority;
+	std::optional<int> nice;
+
+	static thread_config from_env(const std::string& key) {
+		thread_config config;
+		if (const char* cpus = std::getenv(("ILLIXR_THREAD_CPUS_" + key).c_str())) {
+			config.cpus = parse_cpus(cpus);
+		}
+		if (const char* sched = std::getenv(("ILLIXR_THREAD_SCHED_" + key).c_str())) {
+			const std::string spec {sched};
+			const std::size_t colon = spec.find(':');
+			const std::string policy = spec.substr(0, colon);
+			const std::string value = colon == std::string::npos ? "" : spec.substr(colon + 1);
+			if (policy == "fifo" && !value.empty()) {
+				config.fifo_priority = std::stoi(value);
+			} else if (policy == "other") {
+				if (!value.empty()) {
+					config.nice = std::stoi(value);
+				}
+			} else {
+				throw std::runtime_error{"ILLIXR_THREAD_SCHED_" + key + " should be fifo:<priority> or other:<nice>, not " + spec};
+			}
+		}
+		return config;
+	}
+
+	/**
+	 * @brief Parses a comma-separated list of CPUs and ranges, e.g. `2,4-5`.
+	 */
+	static std::vector<int> parse_cpus(const std::string& list) {
+		std::vector<int> cpus;
+		std::istringstream stream {list};
+		std::string item;
+		while (std::getline(stream, item, ',')) {
+			if (item.empty()) {
+				continue;
+			}
+			const std::size_t dash = item.find('-');
+			if (dash == std::string::npos) {
+				cpus.push_back(std::stoi(item));
+			} else {
+				for (int cpu = std::stoi(item.substr(0, dash)); cpu <= std::stoi(item.substr(dash + 1)); ++cpu) {
+					cpus.push_back(cpu);
+				}
+			}
+		}
+		return cpus;
+	}
+
+	/**
+	 * @brief Names the calling thread @p name, and applies this configuration to it.
+	 *
+	 * Setting the policy or affinity may need privileges which ILLIXR does not have, so failures only warn.
+	 */
+	void apply(const std::string& name) const {
+		set_thread_name(name);
+		if (fifo_priority) {
+			sched_param param {};
+			param.sched_priority = *fifo_priority;
+			if (int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+				std::cerr << "Could not run " << name << " under SCHED_FIFO: " << std::strerror(err) << std::endl;
+			}
+		}
+		if (nice) {
+			/* On Linux, the nice value is per-thread. */
+			if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), *nice) != 0) {
+				std::cerr << "Could not set the nice value of " << name << ": " << std::strerror(errno) << std::endl;
+			}
+		}
+		if (!cpus.empty()) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for (int cpu : cpus) {
+				CPU_SET(cpu, &set);
+			}
+			if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+				std::cerr << "Could not pin " << name << ": " << std::strerror(err) << std::endl;
+			}
+		}
+	}
+};
+
+}
@@ -4,8 +4,18 @@
 #include <iostream>
 #include <future>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
 #include "plugin.hpp"
 #include "cpu_timer.hpp"
+#include "executor.hpp"
+#include "perf_counters.hpp"
+#include "precise_sleep.hpp"
+#include "switchboard.hpp"
+#include "thread_config.hpp"
 
 namespace ILLIXR {
 
@@ -17,25 +27,65 @@ const record_header __threadloop_iteration_header {"threadloop_iteration", {
 	{"cpu_time_stop" , typeid(std::chrono::nanoseconds)},
 	{"wall_time_start", typeid(std::chrono::high_resolution_clock::time_point)},
 	{"wall_time_stop" , typeid(std::chrono::high_resolution_clock::time_point)},
+	/* From perf_counters (0 unless ILLIXR_PERF_COUNTERS=y). */
+	{"cycles", typeid(std::size_t)},
+	{"instructions", typeid(std::size_t)},
+	{"cache_misses", typeid(std::size_t)},
+	{"context_switches", typeid(std::size_t)},
 }};
 
+const record_header __threadloop_overrun_header {"threadloop_overrun", {
+	{"plugin_id", typeid(std::size_t)},
+	{"iteration_no", typeid(std::size_t)},
+	{"deadline", typeid(std::chrono::nanoseconds)},
+	/* How long after its deadline the iteration finished (or, if skipped, was expected to). */
+	{"lateness", typeid(std::chrono::nanoseconds)},
+	{"skipped", typeid(bool)},
+}};
+
+/* The column types of the headers above, in order. */
+typedef typed_record_coalescer<
+	std::size_t, std::size_t, std::size_t,
+	std::chrono::nanoseconds, std::chrono::nanoseconds,
+	std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point,
+	std::size_t, std::size_t, std::size_t, std::size_t
+> __threadloop_iteration_coalescer;
+typedef typed_record_coalescer<std::size_t, std::size_t, std::chrono::nanoseconds, std::chrono::nanoseconds, bool> __threadloop_overrun_coalescer;
+
 /**
  * @brief A reusable threadloop for plugins.
  *
  * The thread continuously runs `_p_one_iteration()` and is stopable by `stop()`.
  *
+ * By default, iterations run back-to-back, gated by `_p_should_skip()`. A plugin which waits
+ * for something should instead declare a wake source (`wake_on()`, `wake_every()`, or
+ * `wake_at()`), so the thread sleeps until it is triggered, rather than spinning or sleeping
+ * on its own. A plugin which must finish in time should also declare a deadline
+ * (`set_deadline()`), so that overruns are logged, and optionally skipped instead.
+ *
+ * A plugin which only waits through its wake source can also let its iterations run as tasks on
+ * the runtime's shared executor, instead of on a thread of its own (see `run_as_tasks()`).
+ *
  * This factors out the common code I noticed in many different plugins.
  */
 class threadloop : public plugin {
 public:
-	threadloop(std::string name_, phonebook* pb_) : plugin(name_, pb_) { }
+	threadloop(std::string name_, phonebook* pb_)
+		: plugin(name_, pb_)
+		, _m_sleeper{name_, record_logger_}
+	{ }
 
 	/**
-	 * @brief Starts the thread.
+	 * @brief Starts the thread (or the first task).
 	 */
 	virtual void start() override {
 		plugin::start();
-		_m_thread = std::thread(std::bind(&threadloop::thread_main, this));
+		if (_m_run_as_tasks && executor::enabled()) {
+			_m_task = std::make_shared<loop_task>(this, pb->lookup_impl<executor>(), record_logger_);
+			submit_step(_m_task);
+		} else {
+			_m_thread = std::thread(std::bind(&threadloop::thread_main, this));
+		}
 	}
 
 	/**
@@ -43,8 +93,21 @@ public:
 	 */
 	virtual void stop() override {
 		if (! _m_terminate.load()) {
-			_m_terminate.store(true);
-			_m_thread.join();
+			{
+				/* Wakes a thread sleeping until a deadline (see wait_for_wake). */
+				const std::lock_guard<std::mutex> lock{_m_wake_lock};
+				_m_terminate.store(true);
+			}
+			_m_wake_cv.notify_all();
+			if (_m_task) {
+				/* Waits out a running step. Later ones (queued, or in a topic's watchers) see that I am gone. */
+				const std::lock_guard<std::mutex> lock{_m_task->lock};
+				_m_task->loop = nullptr;
+				_m_task->it_log.flush();
+				_m_task->overrun_log.flush();
+			} else {
+				_m_thread.join();
+			}
 			std::cerr << "Joined " << name << std::endl;
 			plugin::stop();
 		} else {
@@ -65,44 +128,75 @@ protected:
 
 private:
 	void thread_main() {
-		record_coalescer it_log {record_logger_};
+		__threadloop_iteration_coalescer it_log {record_logger_, __threadloop_iteration_header};
+		__threadloop_overrun_coalescer overrun_log {record_logger_, __threadloop_overrun_header};
+		/* Before _p_thread_setup, so that anything it starts inherits the affinity. */
+		thread_config::from_env(name).apply(name);
 		std::cout << "thread," << std::this_thread::get_id() << ",threadloop," << name << std::endl;
 
 		_p_thread_setup();
 
 		while (!should_terminate()) {
-			skip_option s = _p_should_skip();
-
-			switch (s) {
-			case skip_option::skip_and_yield:
-				std::this_thread::yield();
-				++skip_no;
-				break;
-			case skip_option::skip_and_spin:
-				++skip_no;
-				break;
-			case skip_option::run: {
-				auto iteration_start_cpu_time  = thread_cpu_time();
-				auto iteration_start_wall_time = std::chrono::high_resolution_clock::now();
-				_p_one_iteration();
-				it_log.log(record{__threadloop_iteration_header, {
-					{id},
-					{iteration_no},
-					{skip_no},
-					{iteration_start_cpu_time},
-					{thread_cpu_time()},
-					{iteration_start_wall_time},
-					{std::chrono::high_resolution_clock::now()},
-				}});
-				++iteration_no;
-				skip_no = 0;
-				break;
+			if (!wait_for_wake()) {
+				continue;
 			}
-			case skip_option::stop:
+
+			if (!run_once(it_log, overrun_log)) {
 				stop();
+			}
+		}
+	}
+
+	/**
+	 * @brief Runs (or skips) the iteration which is due.
+	 *
+	 * @return false if the plugin asked to stop.
+	 */
+	bool run_once(__threadloop_iteration_coalescer& it_log, __threadloop_overrun_coalescer& overrun_log) {
+		skip_option s = _p_should_skip();
+
+		switch (s) {
+		case skip_option::skip_and_yield:
+			std::this_thread::yield();
+			++skip_no;
+			break;
+		case skip_option::skip_and_spin:
+			++skip_no;
+			break;
+		case skip_option::run: {
+			if (skip_if_stale(overrun_log)) {
+				++skip_no;
 				break;
 			}
+			const perf_counters& counters = perf_counters::this_thread();
+			const perf_counters::sample counters_start = counters.read();
+			auto iteration_start_cpu_time  = thread_cpu_time();
+			auto iteration_start_wall_time = std::chrono::high_resolution_clock::now();
+			const auto start = std::chrono::steady_clock::now();
+			_p_one_iteration();
+			const perf_counters::sample counted = counters.read() - counters_start;
+			check_overrun(start, overrun_log);
+			it_log.log(
+				id,
+				iteration_no,
+				skip_no,
+				iteration_start_cpu_time,
+				thread_cpu_time(),
+				iteration_start_wall_time,
+				std::chrono::high_resolution_clock::now(),
+				std::size_t(counted.cycles),
+				std::size_t(counted.instructions),
+				std::size_t(counted.cache_misses),
+				std::size_t(counted.context_switches)
+			);
+			++iteration_no;
+			skip_no = 0;
+			break;
+		}
+		case skip_option::stop:
+			return false;
 		}
+		return true;
 	}
 
 protected:
@@ -118,12 +212,115 @@ protected:
 		/// the order of 1-10ms. This is nicer to the other threads in the system.
 		skip_and_yield,
 
-		/// Calls stop.
+		/// Calls stop. (Running as tasks, it only stops running iterations, until the runtime stops the plugin.)
 		stop,
 	};
 
 	/**
-	 * @brief Gets called in a tight loop, to gate the invocation of `_p_one_iteration()`
+	 * @brief Runs an iteration for each new event on @p topic, which is stored in @p latest first.
+	 *
+	 * Like `reader::wait_next`, events published during an iteration are coalesced into the
+	 * latest (compare `topic.seq()` between iterations to count them).
+	 * Call this from the constructor or `_p_thread_setup()`.
+	 */
+	template <typename event>
+	void wake_on(reader<event>& topic, std::shared_ptr<const event>& latest) {
+		_m_wake_kind = wake_kind::topic;
+		_m_wait_topic = [&topic, &latest](std::chrono::nanoseconds timeout) {
+			latest = topic.wait_next(timeout);
+			return latest != nullptr;
+		};
+		_m_notify_topic = [&topic](std::function<void()> callback) {
+			topic.notify_next(std::move(callback));
+		};
+	}
+
+	/**
+	 * @brief Runs an iteration every @p period, starting one period from now.
+	 *
+	 * Wake times are fixed multiples of @p period from the start, so a late wake-up or a long
+	 * iteration does not shift the ones after it. If the thread falls more than a period behind,
+	 * the missed wake-ups are counted as skips rather than run back-to-back.
+	 */
+	void wake_every(std::chrono::nanoseconds period) {
+		assert(period.count() > 0);
+		_m_wake_kind = wake_kind::periodic;
+		_m_wake_period = period;
+		_m_wake_time = std::chrono::steady_clock::now() + period;
+	}
+
+	/**
+	 * @brief Runs the next iteration at @p deadline (or right away, if it has passed).
+	 *
+	 * Each deadline triggers one wake-up, even if `_p_should_skip()` then skips it. Call this
+	 * again (e.g. from `_p_one_iteration()`) to set the next one; until then, the thread sleeps.
+	 *
+	 * Like the other wake sources, only call this from the constructor or the thread itself.
+	 */
+	template <typename Clock, typename Duration>
+	void wake_at(std::chrono::time_point<Clock, Duration> deadline) {
+		_m_wake_kind = wake_kind::deadline;
+		if constexpr (std::is_same_v<Clock, std::chrono::steady_clock>) {
+			_m_wake_time = std::chrono::time_point_cast<std::chrono::steady_clock::duration>(deadline);
+		} else {
+			_m_wake_time = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline - Clock::now());
+		}
+	}
+
+	enum class overrun_policy {
+		/// Run every iteration, however late it is.
+		run_late,
+
+		/// Skip an iteration which is not expected to finish by its deadline.
+		skip_stale,
+	};
+
+	/**
+	 * @brief Gives each iteration a deadline, @p deadline after it became due.
+	 *
+	 * An iteration is due at its scheduled time under `wake_every()` and `wake_at()`, and when
+	 * the thread wakes up otherwise. (So with `wake_every(period)`, a deadline of `period` means
+	 * "done before the next one is due".) Iterations which finish late are logged in a
+	 * `threadloop_overrun` record.
+	 *
+	 * Under overrun_policy::skip_stale, an iteration is skipped (and counted in `skip_no`) if it
+	 * would finish late, going by a moving average of recent iterations' wall time. Use this
+	 * where a late result is worse than none, and a skipped input is no loss; otherwise, see
+	 * `iteration_is_stale()`. Call this from the constructor or `_p_thread_setup()`.
+	 */
+	void set_deadline(std::chrono::nanoseconds deadline, overrun_policy policy = overrun_policy::run_late) {
+		assert(deadline.count() > 0);
+		_m_deadline = deadline;
+		_m_overrun_policy = policy;
+	}
+
+	/**
+	 * @brief Whether the running iteration is not expected to finish by its deadline, by the same
+	 * estimate as overrun_policy::skip_stale. False without a deadline.
+	 *
+	 * For a plugin which must take in every input, but may skip a late output: under
+	 * overrun_policy::run_late, ingest the input, then skip the rest of the iteration if this is true.
+	 */
+	bool iteration_is_stale() const {
+		return _m_deadline && std::chrono::steady_clock::now() + _m_expected_runtime > _m_due + *_m_deadline;
+	}
+
+	/**
+	 * @brief Lets the iterations run as tasks on the runtime's shared executor, when there is one
+	 * (see common/executor.hpp), rather than on a thread of this plugin's own.
+	 *
+	 * Only for plugins which wait only through their wake source, and keep no thread-local state
+	 * (e.g. a GL context) between iterations: `_p_thread_setup()` and each iteration may run on a
+	 * different worker (though never two at once). This plugin's `ILLIXR_THREAD_*` settings do not
+	 * apply then. Iterations must not block, e.g. by publishing to a full `overflow_policy::block`
+	 * queue; see the executor's notes on blocking. Call this from the constructor.
+	 */
+	void run_as_tasks() {
+		_m_run_as_tasks = true;
+	}
+
+	/**
+	 * @brief Gets called in a tight loop (or once per wake-up), to gate the invocation of `_p_one_iteration()`
 	 */
 	virtual skip_option _p_should_skip() { return skip_option::run; }
 
@@ -139,6 +336,14 @@ protected:
 	 */
 	virtual void _p_one_iteration() = 0;
 
+	/**
+	 * @brief This thread's precise_sleeper, for plugins which also pace themselves within an
+	 * iteration (e.g. waiting for vsync). Only use it from the thread itself.
+	 */
+	precise_sleeper& sleeper() {
+		return _m_sleeper;
+	}
+
 	/**
 	 * @brief Whether the thread has been asked to terminate.
 	 *
@@ -149,8 +354,213 @@ protected:
 	}
 
 private:
+	enum class wake_kind {
+		/* Run back-to-back. */
+		none,
+		topic,
+		periodic,
+		deadline,
+	};
+
+	/* Bounds how long a wait on a topic can delay noticing stop(). */
+	static constexpr std::chrono::milliseconds MAX_TOPIC_WAIT {100};
+
+	/* Timed waits end with up to this long in _m_sleeper, which stop() cannot interrupt. */
+	static constexpr std::chrono::milliseconds PRECISE_SLEEP_WINDOW {2};
+
+	/**
+	 * @brief Sleeps until the wake source triggers.
+	 *
+	 * @return false if woken for another reason (e.g. stop()), in which case no iteration is due.
+	 */
+	bool wait_for_wake() {
+		switch (_m_wake_kind) {
+		case wake_kind::none:
+			_m_due = std::chrono::steady_clock::now();
+			return true;
+		case wake_kind::topic:
+			if (!_m_wait_topic(MAX_TOPIC_WAIT)) {
+				return false;
+			}
+			_m_due = std::chrono::steady_clock::now();
+			return true;
+		case wake_kind::periodic:
+		case wake_kind::deadline: {
+			{
+				std::unique_lock<std::mutex> lock{_m_wake_lock};
+				if (_m_wake_time == std::chrono::steady_clock::time_point::max()) {
+					/* No deadline set; only stop() can wake me. */
+					_m_wake_cv.wait(lock, [this] { return _m_terminate.load(); });
+					return false;
+				}
+				if (_m_wake_cv.wait_until(lock, _m_wake_time - PRECISE_SLEEP_WINDOW, [this] { return _m_terminate.load(); })) {
+					return false;
+				}
+			}
+			finish_timed_wait();
+			return true;
+		}
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Sleeps the rest of the way to _m_wake_time, and sets the next one.
+	 */
+	void finish_timed_wait() {
+		_m_sleeper.sleep_until(_m_wake_time);
+		_m_due = _m_wake_time;
+		if (_m_wake_kind == wake_kind::deadline) {
+			/* Spent. Sleep until the plugin sets another. */
+			_m_wake_time = std::chrono::steady_clock::time_point::max();
+			return;
+		}
+		_m_wake_time += _m_wake_period;
+		const auto now = std::chrono::steady_clock::now();
+		if (_m_wake_time <= now) {
+			const auto missed = (now - _m_wake_time) / _m_wake_period + 1;
+			skip_no += missed;
+			_m_wake_time += missed * _m_wake_period;
+		}
+	}
+
+	/**
+	 * @brief What a threadloop running as tasks shares with the tasks (and topic watchers) it has queued.
+	 *
+	 * Proof of thread-safety:
+	 * - At most one step runs at a time, under lock; so the threadloop's own state is only touched
+	 *   by one worker at a time, like by its own thread.
+	 * - stop() clears loop under lock, after which no step touches the threadloop.
+	 * - submit_step does not take the lock, so a step can re-queue itself, and a topic watcher
+	 *   called by the step itself (see reader::notify_next) does not deadlock.
+	 */
+	struct loop_task {
+		loop_task(threadloop* loop_, std::shared_ptr<executor> exec_, std::shared_ptr<record_logger> logger)
+			: loop{loop_}
+			, exec{std::move(exec_)}
+			, it_log{logger, __threadloop_iteration_header}
+			, overrun_log{logger, __threadloop_overrun_header}
+		{ }
+
+		std::mutex lock;
+		/* Null once the threadloop has stopped. */
+		threadloop* loop;
+		const std::shared_ptr<executor> exec;
+		bool set_up = false;
+		__threadloop_iteration_coalescer it_log;
+		__threadloop_overrun_coalescer overrun_log;
+	};
+
+	static executor::task step_task(const std::shared_ptr<loop_task>& task) {
+		return [task]() {
+			const std::lock_guard<std::mutex> lock{task->lock};
+			if (task->loop) {
+				task->loop->step(task);
+			}
+		};
+	}
+
+	static void submit_step(const std::shared_ptr<loop_task>& task) {
+		task->exec->submit(step_task(task));
+	}
+
+	/**
+	 * @brief The task-mode counterpart of thread_main's loop body: runs the iteration if one is due,
+	 * then queues the next step for when the next one will be.
+	 */
+	void step(const std::shared_ptr<loop_task>& task) {
+		if (!task->set_up) {
+			task->set_up = true;
+			_p_thread_setup();
+		}
+		if (should_terminate()) {
+			return;
+		}
+		switch (_m_wake_kind) {
+		case wake_kind::none:
+			_m_due = std::chrono::steady_clock::now();
+			break;
+		case wake_kind::topic:
+			if (!_m_wait_topic(std::chrono::nanoseconds{0})) {
+				_m_notify_topic([task]() {
+					submit_step(task);
+				});
+				return;
+			}
+			_m_due = std::chrono::steady_clock::now();
+			break;
+		case wake_kind::periodic:
+		case wake_kind::deadline:
+			if (_m_wake_time == std::chrono::steady_clock::time_point::max()) {
+				/* No deadline set; nothing to do until stop(). */
+				return;
+			}
+			if (std::chrono::steady_clock::now() < _m_wake_time - PRECISE_SLEEP_WINDOW) {
+				task->exec->submit_at(_m_wake_time - PRECISE_SLEEP_WINDOW, step_task(task));
+				return;
+			}
+			finish_timed_wait();
+			break;
+		}
+		if (run_once(task->it_log, task->overrun_log)) {
+			/* The next step waits as needed (above), so that it alone has to know how. */
+			submit_step(task);
+		}
+	}
+
+	/**
+	 * @brief Under overrun_policy::skip_stale, logs and returns true if the due iteration would finish late.
+	 */
+	bool skip_if_stale(__threadloop_overrun_coalescer& overrun_log) {
+		if (!_m_deadline || _m_overrun_policy != overrun_policy::skip_stale) {
+			return false;
+		}
+		const auto lateness = std::chrono::steady_clock::now() + _m_expected_runtime - (_m_due + *_m_deadline);
+		if (lateness.count() <= 0) {
+			return false;
+		}
+		overrun_log.log(id, iteration_no, *_m_deadline, std::chrono::duration_cast<std::chrono::nanoseconds>(lateness), true);
+		/* Otherwise, one slow iteration could keep the estimate (and so the skipping) up forever. */
+		_m_expected_runtime -= _m_expected_runtime / 8;
+		return true;
+	}
+
+	void check_overrun(std::chrono::steady_clock::time_point start, __threadloop_overrun_coalescer& overrun_log) {
+		if (!_m_deadline) {
+			return;
+		}
+		const auto stop = std::chrono::steady_clock::now();
+		_m_expected_runtime += (std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start) - _m_expected_runtime) / 8;
+		const auto lateness = stop - (_m_due + *_m_deadline);
+		if (lateness.count() > 0) {
+			overrun_log.log(id, iteration_no, *_m_deadline, std::chrono::duration_cast<std::chrono::nanoseconds>(lateness), false);
+		}
+	}
+
 	std::atomic<bool> _m_terminate {false};
 
+	/* Only touched by the thread itself, except before it starts. */
+	wake_kind _m_wake_kind = wake_kind::none;
+	std::function<bool(std::chrono::nanoseconds)> _m_wait_topic;
+	std::function<void(std::function<void()>)> _m_notify_topic;
+	std::chrono::nanoseconds _m_wake_period {0};
+	std::chrono::steady_clock::time_point _m_wake_time = std::chrono::steady_clock::time_point::max();
+	/* Lets stop() interrupt a timed sleep. */
+	std::mutex _m_wake_lock;
+	std::condition_variable _m_wake_cv;
+	precise_sleeper _m_sleeper;
+
+	/* Only touched by the thread itself, except before it starts. */
+	std::optional<std::chrono::nanoseconds> _m_deadline;
+	overrun_policy _m_overrun_policy = overrun_policy::run_late;
+	/* When the current iteration became due. */
+	std::chrono::steady_clock::time_point _m_due;
+	/* Moving average of the wall time of an iteration. */
+	std::chrono::nanoseconds _m_expected_runtime {0};
+
+	bool _m_run_as_tasks = false;
+	/* Set iff running as tasks, instead of on _m_thread. */
+	std::shared_ptr<loop_task> _m_task;
 	std::thread _m_thread;
 };
 
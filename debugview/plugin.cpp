@@ -62,10 +62,10 @@ public:
 		//, glfw_context{pb->lookup_impl<global_config>()->glfw_context}
 	{}
 
-	void imu_cam_handler(const imu_cam_type *datum) {
-		if(datum == NULL){ return; }
+	void imu_cam_handler(std::shared_ptr<const imu_cam_type> datum) {
+		if(datum == nullptr){ return; }
 		if(datum->img0.has_value() && datum->img1.has_value())
-			last_datum_with_images = datum;
+			std::atomic_store(&last_datum_with_images, datum);
 	}
 
 	void draw_GUI() {
@@ -128,7 +128,7 @@ public:
 		ImGui::Text("Slow pose topic:");
 		ImGui::SameLine();
 
-		const pose_type* slow_pose_ptr = _m_slow_pose->get_latest_ro();
+		auto slow_pose_ptr = _m_slow_pose->get_latest_ro();
 		if(slow_pose_ptr){
 			ImGui::TextColored(ImVec4(0.0, 1.0, 0.0, 1.0), "Valid slow pose pointer");
 			ImGui::Text("Slow pose position (XYZ):\n  (%f, %f, %f)", slow_pose_ptr->position.x(), slow_pose_ptr->position.y(), slow_pose_ptr->position.z());
@@ -174,13 +174,14 @@ public:
 	}
 
 	bool load_camera_images(){
-		if(last_datum_with_images == NULL){
+		auto datum = std::atomic_load(&last_datum_with_images);
+		if(datum == nullptr){
 			return false;
 		}
-		if(last_datum_with_images->img0.has_value()){
+		if(datum->img0.has_value()){
 			glBindTexture(GL_TEXTURE_2D, camera_textures[0]);
 			cv::Mat img0;
-			cv::cvtColor(*last_datum_with_images->img0.value(), img0, cv::COLOR_BGR2GRAY);
+			cv::cvtColor(datum->img0.value(), img0, cv::COLOR_BGR2GRAY);
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, img0.cols, img0.rows, 0, GL_RED, GL_UNSIGNED_BYTE, img0.ptr());
 			camera_texture_sizes[0] = Eigen::Vector2i(img0.cols, img0.rows);
 			GLint swizzleMask[] = {GL_RED, GL_RED, GL_RED, GL_RED};
@@ -193,10 +194,10 @@ public:
 			camera_texture_sizes[0] = Eigen::Vector2i(TEST_PATTERN_WIDTH, TEST_PATTERN_HEIGHT);
 		}
 		
-		if(last_datum_with_images->img1.has_value()){
+		if(datum->img1.has_value()){
 			glBindTexture(GL_TEXTURE_2D, camera_textures[1]);
 			cv::Mat img1;
-			cv::cvtColor(*last_datum_with_images->img1.value(), img1, cv::COLOR_BGR2GRAY);
+			cv::cvtColor(datum->img1.value(), img1, cv::COLOR_BGR2GRAY);
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, img1.cols, img1.rows, 0, GL_RED, GL_UNSIGNED_BYTE, img1.ptr());
 			camera_texture_sizes[1] = Eigen::Vector2i(img1.cols, img1.rows);
 			GLint swizzleMask[] = {GL_RED, GL_RED, GL_RED, GL_RED};
@@ -350,7 +351,9 @@ private:
 	Eigen::Vector3f tracking_position_offset = Eigen::Vector3f{0.0f, 0.0f, 0.0f};
 
 
-	const imu_cam_type* last_datum_with_images = NULL;
+	// Written by the switchboard callback thread, read by the GUI thread.
+	// Accessed only through std::atomic_load and std::atomic_store.
+	std::shared_ptr<const imu_cam_type> last_datum_with_images;
 	// std::vector<std::optional<cv::Mat>> camera_data = {std::nullopt, std::nullopt};
 	GLuint camera_textures[2];
 	Eigen::Vector2i camera_texture_sizes[2] = {Eigen::Vector2i::Zero(), Eigen::Vector2i::Zero()};
@@ -379,9 +382,11 @@ public:
 		// It serves more as an event stream. Camera frames are only available on this topic
 		// the very split second they are made available. Subsequently published packets to this
 		// topic do not contain the camera frames.
-   		sb->schedule<imu_cam_type>(id, "imu_cam", [&](const imu_cam_type *datum) {
+		// Background callbacks may wait a long time under load; then drop the oldest packets
+		// (and maybe a frame) rather than hold up the IMU/pose path publishing them.
+   		sb->schedule<imu_cam_type>(id, "imu_cam", [&](std::shared_ptr<const imu_cam_type> datum) {
         	this->imu_cam_handler(datum);
-    	});
+    	}, queue_policy{8, overflow_policy::drop_oldest, priority_class::background});
 
 		glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
 		const char* glsl_version = "#version 430 core";
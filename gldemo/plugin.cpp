@@ -49,7 +49,7 @@ public:
 	void wait_vsync()
 	{
 		using namespace std::chrono_literals;
-		const time_type* next_vsync = vsync->get_latest_ro();
+		auto next_vsync = vsync->get_latest_ro();
 		time_type now = std::chrono::high_resolution_clock::now();
 
 		time_type wait_time;
@@ -58,7 +58,7 @@ public:
 		{
 			// If no vsync data available, just sleep for roughly a vsync period.
 			// We'll get synced back up later.
-			std::this_thread::sleep_for(vsync_period);
+			sleeper().sleep_for(vsync_period);
 			return;
 		}
 
@@ -93,10 +93,8 @@ public:
 			return;
 		}
 
-		// Perform the sleep.
-		// TODO: Consider using Monado-style sleeping, where we nanosleep for
-		// most of the wait, and then spin-wait for the rest?
-		std::this_thread::sleep_until(wait_time);
+		// Perform the sleep, Monado-style: nanosleep for most of the wait, then spin-wait for the rest.
+		sleeper().sleep_until(wait_time);
 	}
 
 	void _p_thread_setup() override {
@@ -185,7 +183,7 @@ public:
 			glFlush();
 
 			// Publish our submitted frame handle to Switchboard!
-			auto frame = new rendered_frame;
+			auto frame = _m_eyebuffer->allocate();
 			frame->texture_handles[0] = eyeTextures[0];
 			frame->texture_handles[1] = eyeTextures[1];
 			frame->swap_indices[0] = buffer_to_use;
@@ -36,7 +36,8 @@ public:
 			return;
 		}
 
-		pose_type* true_pose = new pose_type{_m_sensor_data_it->second};
+		auto true_pose = _m_true_pose->allocate();
+		*true_pose = _m_sensor_data_it->second;
 		true_pose->sensor_time = datum->time;
 		// std::cout << "The pose was found at " << true_pose->position[0] << ", " << true_pose->position[1] << ", " << true_pose->position[2] << std::endl; 
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
 #include <thread>
@@ -35,51 +36,53 @@ public:
 	imu_integrator(std::string name_, phonebook* pb_)
 		: threadloop{name_, pb_}
 		, sb{pb->lookup_impl<switchboard>()}
-		, _m_imu_cam{sb->subscribe_latest<imu_cam_type>("imu_cam")}
-		, _m_in{sb->subscribe_latest<imu_integrator_seq>("imu_integrator_seq")}
+		, _m_imu_cam{sb->subscribe<imu_cam_type>("imu_cam")}
 		, _m_imu_integrator_input{sb->subscribe_latest<imu_integrator_input>("imu_integrator_input")}
 		, _m_imu_raw{sb->publish<imu_raw_type>("imu_raw")}
-		, _seq_expect(1)
-	{}
-
-	virtual skip_option _p_should_skip() override {
-		auto in = _m_in->get_latest_ro();
-		if (!in || in->seq == _seq_expect-1) {
-			// No new data, sleep to keep CPU utilization low
-			std::this_thread::sleep_for(std::chrono::milliseconds{1});
-			return skip_option::skip_and_yield;
-		} else {
-			if (in->seq != _seq_expect) {
-				_stat_missed = in->seq - _seq_expect;
-			} else {
-				_stat_missed = 0;
-			}
-			_stat_processed++;
-			_seq_expect = in->seq+1;
-			return skip_option::run;
-		}
+		, _stat_processed{0}
+		, _stat_missed{0}
+		, _stat_stale{0}
+	{
+		// Sleep until the next IMU sample.
+		wake_on(*_m_imu_cam, _m_datum);
+		// A pose integrated after the next sample (5ms at 200Hz) has arrived is already stale;
+		// better to skip it. Every sample is still needed by later integrations, so only the
+		// propagation is skipped, never the sample (see _p_one_iteration).
+		set_deadline(std::chrono::milliseconds{5});
+		run_as_tasks();
 	}
 
 	void _p_one_iteration() override {
-		const imu_cam_type *datum = _m_imu_cam->get_latest_ro();
-		double timestamp_in_seconds = (double(datum->dataset_time) / NANO_SEC);
+		// Samples skipped since the previous iteration; none if the sample has not advanced
+		// (e.g. after a timeout), nor before the first one.
+		const std::uint64_t seq = _m_imu_cam->seq();
+		_stat_missed = (_m_last_seq > 0 && seq > _m_last_seq) ? seq - _m_last_seq - 1 : 0;
+		_m_last_seq = std::max(_m_last_seq, seq);
+		_stat_processed++;
+
+		double timestamp_in_seconds = (double(_m_datum->dataset_time) / NANO_SEC);
 
 		imu_type data;
         data.timestamp = timestamp_in_seconds;
-        data.wm = (datum->angular_v).cast<double>();
-        data.am = (datum->linear_a).cast<double>();
+        data.wm = (_m_datum->angular_v).cast<double>();
+        data.am = (_m_datum->linear_a).cast<double>();
 		_imu_vec.emplace_back(data);
 
 		clean_imu_vec(timestamp_in_seconds);
-        propagate_imu_values(timestamp_in_seconds, datum->time);
+		if (iteration_is_stale()) {
+			_stat_stale++;
+			return;
+		}
+        propagate_imu_values(timestamp_in_seconds, _m_datum->time);
 	}
 
 private:
 	const std::shared_ptr<switchboard> sb;
 
-	// IMU Data, Sequence Flag, and State Vars Needed
-	std::unique_ptr<reader_latest<imu_cam_type>> _m_imu_cam;
-	std::unique_ptr<reader_latest<imu_integrator_seq>> _m_in;
+	// IMU Data and State Vars Needed
+	std::unique_ptr<reader<imu_cam_type>> _m_imu_cam;
+	std::shared_ptr<const imu_cam_type> _m_datum;
+	std::uint64_t _m_last_seq = 0;
 	std::unique_ptr<reader_latest<imu_integrator_input>> _m_imu_integrator_input;
 
 	// Write IMU Biases for PP
@@ -90,7 +93,7 @@ private:
 
 	[[maybe_unused]] double last_cam_time = 0;
 	double last_imu_offset = 0;
-	long long _seq_expect, _stat_processed, _stat_missed;
+	std::uint64_t _stat_processed, _stat_missed, _stat_stale;
 
 	// Remove IMU values older than 'IMU_TTL' from the imu buffer
 	void clean_imu_vec(double timestamp) {
@@ -109,8 +112,8 @@ private:
 
 	// Timestamp we are propagating the biases to (new IMU reading time)
 	void propagate_imu_values(double timestamp, time_type real_time) {
-		const imu_integrator_input *input_values = _m_imu_integrator_input->get_latest_ro();
-		if (input_values == NULL) {
+		auto input_values = _m_imu_integrator_input->get_latest_ro();
+		if (!input_values) {
 			return;
 		}
 
@@ -180,7 +183,8 @@ private:
 				<< out_pose.z() << std::endl;
 #endif
 
-		_m_imu_raw->put(new imu_raw_type{
+		auto imu_raw = _m_imu_raw->allocate();
+		*imu_raw = imu_raw_type{
 			prev_bias.gyroscope(),
 			prev_bias.accelerometer(),
 			bias.gyroscope(),
@@ -189,7 +193,8 @@ private:
 			navstate_k.velocity(), // Velocity
 			out_pose.rotation().toQuaternion(), // Eigen Quat
 			real_time
-		});
+		};
+		_m_imu_raw->put(imu_raw);
 	}
 
 	// Select IMU readings based on timestamp similar to how OpenVINS selects IMU values to propagate
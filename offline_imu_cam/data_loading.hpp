@@ -1,13 +1,16 @@
 #include <map>
 #include <fstream>
+#include <iostream>
 #include <string>
 #include <optional>
+#include <vector>
 
 #include <opencv2/core/mat.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 #include <eigen3/Eigen/Dense>
 
+#include "common/image_pool.hpp"
 #include "csv_iterator.hpp"
 
 typedef unsigned long long ullong;
@@ -22,10 +25,31 @@ public:
 	lazy_load_image(const std::string& path)
 		: _m_path(path)
 	{ }
-	std::unique_ptr<cv::Mat> load() const {
-		auto img = std::unique_ptr<cv::Mat>{new cv::Mat{cv::imread(_m_path, cv::IMREAD_COLOR)}};
+	/**
+	 * @brief Decodes the image into a buffer borrowed from @p pool.
+	 *
+	 * @p file_buffer is scratch space for the encoded file, kept by the caller so it is reused too.
+	 */
+	cv::Mat load(ILLIXR::image_pool& pool, std::vector<uchar>& file_buffer) const {
+		std::ifstream file {_m_path, std::ios::binary | std::ios::ate};
+		const std::streamoff size = file ? static_cast<std::streamoff>(file.tellg()) : -1;
+		if (size < 0) {
+			/* Like cv::imread, which this replaced, give back an empty image. */
+			std::cerr << "Could not read image " << _m_path << std::endl;
+			return cv::Mat{};
+		}
+		file_buffer.resize(size);
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(file_buffer.data()), file_buffer.size())) {
+			std::cerr << "Could not read image " << _m_path << std::endl;
+			return cv::Mat{};
+		}
+
+		cv::Mat img = pool.borrow([&](cv::Mat& mat) {
+			cv::imdecode(file_buffer, cv::IMREAD_COLOR, &mat);
+		});
 		/* TODO: make this load in grayscale */
-		assert(!img->empty());
+		assert(!img.empty());
 
 		// Sam's note: I am moving cvtColor into slam2
 		// This way, all of the cv calls are being done from the same thread.
@@ -6,6 +6,9 @@
 
 using namespace ILLIXR;
 
+/* Frames which may be in flight per camera (held by subscribers or queued) before the pool falls back to the heap. */
+const std::size_t IMAGE_POOL_SIZE = 8;
+
 const record_header imu_cam_record {
 	"imu_cam",
 	{
@@ -22,30 +25,20 @@ public:
 		, _m_sensor_data_it{_m_sensor_data.cbegin()}
 		, _m_sb{pb->lookup_impl<switchboard>()}
 		, _m_imu_cam{_m_sb->publish<imu_cam_type>("imu_cam")}
-		, _m_imu_integrator{_m_sb->publish<imu_integrator_seq>("imu_integrator_seq")}
+		, _m_cam0_pool{IMAGE_POOL_SIZE}
+		, _m_cam1_pool{IMAGE_POOL_SIZE}
 		, dataset_first_time{_m_sensor_data_it->first}
 		, imu_cam_log{record_logger_}
 		, camera_cvtfmt_log{record_logger_}
-	{ }
+	{
+		// Only waits through wake_at, so it can share the executor's workers.
+		run_as_tasks();
+	}
 
 protected:
 	virtual skip_option _p_should_skip() override {
 		if (_m_sensor_data_it != _m_sensor_data.end()) {
-			dataset_now = _m_sensor_data_it->first;
-			// Sleep for the difference between the current IMU vs 1st IMU and current UNIX time vs UNIX time the component was init
-			std::this_thread::sleep_for(
-				std::chrono::nanoseconds{dataset_now - dataset_first_time}
-				+ real_first_time
-				- std::chrono::high_resolution_clock::now()
-			);
-
-			if (_m_sensor_data_it->second.imu0) {
-				return skip_option::run;
-			} else {
-				++_m_sensor_data_it;
-				return skip_option::skip_and_yield;
-			}
-
+			return skip_option::run;
 		} else {
 			return skip_option::stop;
 		}
@@ -64,16 +57,17 @@ protected:
 		}});
 
 
-		std::optional<cv::Mat*> cam0 = sensor_datum.cam0
-			? std::make_optional<cv::Mat*>(sensor_datum.cam0.value().load().release())
+		std::optional<cv::Mat> cam0 = sensor_datum.cam0
+			? std::make_optional<cv::Mat>(sensor_datum.cam0.value().load(_m_cam0_pool, _m_file_buffer))
 			: std::nullopt
 			;
-		std::optional<cv::Mat*> cam1 = sensor_datum.cam1
-			? std::make_optional<cv::Mat*>(sensor_datum.cam1.value().load().release())
+		std::optional<cv::Mat> cam1 = sensor_datum.cam1
+			? std::make_optional<cv::Mat>(sensor_datum.cam1.value().load(_m_cam1_pool, _m_file_buffer))
 			: std::nullopt
 			;
 
-		auto datum = new imu_cam_type{
+		auto datum = _m_imu_cam->allocate();
+		*datum = imu_cam_type{
 			real_now,
 			(sensor_datum.imu0.value().angular_v).cast<float>(),
 			(sensor_datum.imu0.value().linear_a).cast<float>(),
@@ -83,10 +77,7 @@ protected:
 		};
 		_m_imu_cam->put(datum);
 
-		auto imu_integrator_params = new imu_integrator_seq{
-			.seq = static_cast<int>(++_imu_integrator_seq),
-		};
-		_m_imu_integrator->put(imu_integrator_params);
+		wake_at_next_imu();
 	}
 
 public:
@@ -95,14 +86,33 @@ public:
 		// be done at thread-launch time, not load-time.
 		auto now = std::chrono::system_clock::now();
 		real_first_time = std::chrono::time_point_cast<std::chrono::seconds>(now);
+		wake_at_next_imu();
 	}
 
 private:
+	// Sleep until the next IMU sample is due, skipping entries which only have camera data.
+	void wake_at_next_imu() {
+		while (_m_sensor_data_it != _m_sensor_data.end() && !_m_sensor_data_it->second.imu0) {
+			++_m_sensor_data_it;
+		}
+		if (_m_sensor_data_it == _m_sensor_data.end()) {
+			// Wake once more, so that _p_should_skip stops the thread.
+			wake_at(std::chrono::steady_clock::now());
+			return;
+		}
+		dataset_now = _m_sensor_data_it->first;
+		// Due at the difference between the current IMU vs 1st IMU, after the UNIX time the component was init
+		wake_at(real_first_time + std::chrono::nanoseconds{dataset_now - dataset_first_time});
+	}
+
 	const std::map<ullong, sensor_types> _m_sensor_data;
 	std::map<ullong, sensor_types>::const_iterator _m_sensor_data_it;
 	const std::shared_ptr<switchboard> _m_sb;
 	std::unique_ptr<writer<imu_cam_type>> _m_imu_cam;
-	std::unique_ptr<writer<imu_integrator_seq>> _m_imu_integrator;
+	/* Frames are decoded into these, so steady-state publishing allocates no pixel buffers. */
+	image_pool _m_cam0_pool;
+	image_pool _m_cam1_pool;
+	std::vector<uchar> _m_file_buffer;
 
 	// Timestamp of the first IMU value from the dataset
 	ullong dataset_first_time;
@@ -113,7 +123,6 @@ private:
 
 	record_coalescer imu_cam_log;
 	record_coalescer camera_cvtfmt_log;
-	long long _imu_integrator_seq{0};
 };
 
 PLUGIN_MAIN(offline_imu_cam)
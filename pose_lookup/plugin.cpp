@@ -52,7 +52,7 @@ public:
 	return orientation * offset;
     }
     virtual fast_pose_type get_fast_pose([[maybe_unused]] time_type time) const override {
-		const time_type* estimated_vsync = _m_vsync_estimate->get_latest_ro();
+		auto estimated_vsync = _m_vsync_estimate->get_latest_ro();
 		time_type vsync;
 		if(estimated_vsync == nullptr) {
 			std::cerr << "Vsync estimation not valid yet, returning fast_pose for now()" << std::endl;
@@ -21,7 +21,7 @@ public:
 	// However, we don't have vsync estimation yet.
 	// So we will predict to `now()`, as a temporary approximation
     virtual fast_pose_type get_fast_pose() const override {
-		const time_type *vsync_estimate = _m_vsync_estimate->get_latest_ro();
+		auto vsync_estimate = _m_vsync_estimate->get_latest_ro();
 
         if(vsync_estimate == nullptr) {
 		return get_fast_pose(std::chrono::high_resolution_clock::now());
@@ -31,7 +31,7 @@ public:
 	}
 
     virtual pose_type get_true_pose() const override {
-		const pose_type* pose_ptr = _m_true_pose->get_latest_ro();
+		auto pose_ptr = _m_true_pose->get_latest_ro();
 		return correct_pose(
 			pose_ptr ? *pose_ptr : pose_type{
 				.sensor_time = std::chrono::system_clock::now(),
@@ -43,7 +43,7 @@ public:
 
     // future_time: An absolute timepoint in the future
     virtual fast_pose_type get_fast_pose(time_type future_timestamp) const override {
-		const pose_type* slow_pose = _m_slow_pose->get_latest_ro();
+		auto slow_pose = _m_slow_pose->get_latest_ro();
 		if (!slow_pose) {
 			// No slow pose, return 0
             return fast_pose_type{
@@ -53,7 +53,7 @@ public:
             };
 		}
 
-		const imu_raw_type* imu_raw = _m_imu_raw->get_latest_ro();
+		auto imu_raw = _m_imu_raw->get_latest_ro();
         if (!imu_raw) {
 #ifndef NDEBUG
             printf("FAST POSE IS SLOW POSE!");
@@ -145,7 +145,7 @@ public:
 		  We do not have a "ground truth" available in all cases, such
 		  as when reading live data.
 		 */
-		return _m_true_pose->get_latest_ro();
+		return _m_true_pose->get_latest_ro() != nullptr;
 	}
 
 private:
@@ -186,7 +186,7 @@ private:
     std::pair<Eigen::Matrix<double,13,1>,time_type> predict_mean_rk4(double dt) const {
 
         // Pre-compute things
-        const imu_raw_type *imu_raw = _m_imu_raw->get_latest_ro();
+        auto imu_raw = _m_imu_raw->get_latest_ro();
 
         Eigen::Vector3d w_hat =imu_raw->w_hat;
         Eigen::Vector3d a_hat = imu_raw->a_hat;
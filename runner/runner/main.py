@@ -103,6 +103,17 @@ def build_runtime(config: Mapping[str, Any], suffix: str, test: bool = False,) -
     return runtime_path / runtime_name
 
 
+def thread_env(config: Mapping[str, Any]) -> Mapping[str, str]:
+    """Translate the config's `threads` section into the runtime's ILLIXR_THREAD_* vars."""
+    env = {}
+    for key, thread_config in config["threads"].items():
+        if "cpus" in thread_config:
+            env[f"ILLIXR_THREAD_CPUS_{key}"] = str(thread_config["cpus"])
+        if "sched" in thread_config:
+            env[f"ILLIXR_THREAD_SCHED_{key}"] = str(thread_config["sched"])
+    return env
+
+
 def load_native(config: Mapping[str, Any]) -> None:
     runtime_exe_path = build_runtime(config, "exe")
     data_path = pathify(config["data"], root_dir, cache_path, True, True)
@@ -128,7 +139,11 @@ def load_native(config: Mapping[str, Any]) -> None:
     )
     subprocess_run(
         command_lst_sbst,
-        env_override=dict(ILLIXR_DATA=str(data_path), ILLIXR_DEMO_DATA=str(demo_data_path)),
+        env_override=dict(
+            ILLIXR_DATA=str(data_path),
+            ILLIXR_DEMO_DATA=str(demo_data_path),
+            **thread_env(config),
+        ),
     )
 
 
@@ -148,7 +163,12 @@ def load_tests(config: Mapping[str, Any]) -> None:
     )
     subprocess_run(
         ["xvfb-run", str(runtime_exe_path), *map(str, plugin_paths)],
-        env_override=dict(ILLIXR_DATA=str(data_path), ILLIXR_DEMO_DATA=str(demo_data_path), ILLIXR_RUN_DURATION="10"),
+        env_override=dict(
+            ILLIXR_DATA=str(data_path),
+            ILLIXR_DEMO_DATA=str(demo_data_path),
+            ILLIXR_RUN_DURATION="10",
+            **thread_env(config),
+        ),
     )
 
 
@@ -208,6 +228,7 @@ def load_monado(config: Mapping[str, Any]) -> None:
             ILLIXR_COMP=":".join(map(str, plugin_paths)),
             ILLIXR_DATA=str(data_path),
             ILLIXR_DEMO_DATA=str(demo_data_path),
+            **thread_env(config),
         ),
     )
 
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/switchboard.hpp"
+
+namespace ILLIXR {
+
+	/*
+	  Binary log of switchboard traffic, for record-and-replay.
+
+	  The file starts with MAGIC. Then it is a sequence of entries, each starting with a tag byte:
+	  - TOPIC: std::uint32_t topic_id, std::uint64_t type_hash, std::uint64_t layout (see event_type::layout),
+	    std::uint16_t name_size, then the name.
+	  - EVENT: std::uint32_t topic_id, std::int64_t nanoseconds since recording started, std::uint32_t size, then
+	    the event, as encoded by its serializer (see common/serializer.hpp).
+	  Integers are in host byte order; logs are meant to be replayed on the machine (and build) which recorded them.
+	  A topic's TOPIC entry precedes its first EVENT.
+	*/
+	namespace event_log {
+		constexpr char MAGIC[8] = {'I', 'L', 'X', 'L', 'O', 'G', '2', '\0'};
+		enum class tag : std::uint8_t {
+			TOPIC = 0,
+			EVENT = 1,
+		};
+
+		/**
+		 * @brief Appends entries to a log. Called from every writer's put(), so it is thread-safe.
+		 *
+		 * Proof of thread-safety:
+		 * - All accesses to _m_file, _m_entry, and _m_next_topic_id occur after acquiring _m_lock.
+		 * - The lock is only held to copy one entry into the (buffered) stream.
+		 */
+		class writer {
+		public:
+			explicit writer(const std::string& path)
+				: _m_file{path, std::ios::binary | std::ios::trunc}
+				, _m_start{std::chrono::steady_clock::now()}
+			{
+				if (!_m_file.good()) {
+					throw std::runtime_error{"Could not open switchboard log " + path};
+				}
+				_m_file.write(MAGIC, sizeof(MAGIC));
+			}
+
+			/**
+			 * @brief Declares a topic, and returns the id to record its events under.
+			 */
+			std::uint32_t add_topic(const std::string& name, std::size_t type_hash, std::size_t layout) {
+				const std::lock_guard<std::mutex> lock{_m_lock};
+				const std::uint32_t topic_id = _m_next_topic_id++;
+				_m_entry.clear();
+				append(tag::TOPIC);
+				append(topic_id);
+				append(static_cast<std::uint64_t>(type_hash));
+				append(static_cast<std::uint64_t>(layout));
+				append(static_cast<std::uint16_t>(name.size()));
+				_m_entry.insert(_m_entry.end(), name.begin(), name.end());
+				_m_file.write(_m_entry.data(), _m_entry.size());
+				return topic_id;
+			}
+
+			/**
+			 * @brief Appends @p event, which must be serializable.
+			 */
+			void add_event(std::uint32_t topic_id, const event_type& type, const void* event) {
+				const std::int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _m_start).count();
+				const std::size_t size = type.encoded_size(event);
+				const std::lock_guard<std::mutex> lock{_m_lock};
+				_m_entry.clear();
+				append(tag::EVENT);
+				append(topic_id);
+				append(time);
+				append(static_cast<std::uint32_t>(size));
+				/* Encode in place; after the first few events, _m_entry has the capacity already. */
+				const std::size_t header_size = _m_entry.size();
+				_m_entry.resize(header_size + size);
+				type.encode(event, _m_entry.data() + header_size);
+				_m_file.write(_m_entry.data(), _m_entry.size());
+			}
+
+		private:
+			template <typename T>
+			void append(T value) {
+				const char* bytes = reinterpret_cast<const char*>(&value);
+				_m_entry.insert(_m_entry.end(), bytes, bytes + sizeof(value));
+			}
+
+			std::mutex _m_lock;
+			std::ofstream _m_file;
+			/* Scratch space, so each entry reaches the stream in one write. */
+			std::vector<char> _m_entry;
+			std::uint32_t _m_next_topic_id = 0;
+			const std::chrono::steady_clock::time_point _m_start;
+		};
+
+		/**
+		 * @brief Reads a log front-to-back. Not thread-safe; owned by the replay thread.
+		 */
+		class reader {
+		public:
+			struct topic {
+				std::string name;
+				std::size_t type_hash;
+				std::size_t layout;
+			};
+
+			explicit reader(const std::string& path)
+				: _m_file{path, std::ios::binary}
+			{
+				char magic[sizeof(MAGIC)];
+				if (!_m_file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+					throw std::runtime_error{"Not a switchboard log: " + path};
+				}
+			}
+
+			/**
+			 * @brief Reads up to the next event, collecting the topics declared on the way.
+			 *
+			 * @p event receives the encoded event.
+			 *
+			 * @return false at the end of the log (or at a truncated entry, if the recording was cut short).
+			 */
+			bool next(std::uint32_t& topic_id, std::chrono::nanoseconds& time, std::vector<char>& event) {
+				tag t;
+				while (read(t)) {
+					if (t == tag::TOPIC) {
+						std::uint32_t id;
+						std::uint64_t type_hash;
+						std::uint64_t layout;
+						std::uint16_t name_size;
+						if (!read(id) || !read(type_hash) || !read(layout) || !read(name_size)) {
+							return false;
+						}
+						std::string name (name_size, '\0');
+						if (!_m_file.read(name.data(), name_size)) {
+							return false;
+						}
+						if (id >= _m_topics.size()) {
+							_m_topics.resize(id + 1);
+						}
+						_m_topics[id] = topic{std::move(name), static_cast<std::size_t>(type_hash), static_cast<std::size_t>(layout)};
+					} else if (t == tag::EVENT) {
+						std::int64_t ns;
+						std::uint32_t size;
+						if (!read(topic_id) || !read(ns) || !read(size) || topic_id >= _m_topics.size()) {
+							return false;
+						}
+						time = std::chrono::nanoseconds{ns};
+						/* Keeps its capacity from event to event. */
+						event.resize(size);
+						return static_cast<bool>(_m_file.read(event.data(), size));
+					} else {
+						return false;
+					}
+				}
+				return false;
+			}
+
+			const topic& get_topic(std::uint32_t topic_id) const {
+				return _m_topics.at(topic_id);
+			}
+
+		private:
+			template <typename T>
+			bool read(T& value) {
+				return static_cast<bool>(_m_file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+			}
+
+			std::ifstream _m_file;
+			std::vector<topic> _m_topics;
+		};
+	}
+
+}
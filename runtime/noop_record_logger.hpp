@@ -8,5 +8,7 @@ namespace ILLIXR {
 		virtual void log(const record& r) override {
 			r.mark_used();
 		}
+
+		virtual void log(std::unique_ptr<const record_batch>) override { }
 	};
 }
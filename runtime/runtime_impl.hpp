@@ -16,6 +16,10 @@ public:
 	runtime_impl(GLXContext appGLCtx) {
 		pb.register_impl<record_logger>(std::make_shared<sqlite_record_logger>());
 		pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+		if (executor::enabled()) {
+			// Before switchboard, which runs its callbacks on it.
+			pb.register_impl<executor>(std::make_shared<executor>());
+		}
 		pb.register_impl<switchboard>(create_switchboard(&pb));
 		pb.register_impl<xlib_gl_extended_window>(std::make_shared<xlib_gl_extended_window>(448*2, 320*2, appGLCtx));
 	}
@@ -32,6 +36,8 @@ public:
 	}
 
 	virtual void wait() override {
+		// Every plugin is loaded by now, so a replay reaches all of their subscriptions.
+		std::dynamic_pointer_cast<switchboard_impl>(pb.lookup_impl<switchboard>())->start_replay();
 		while (!terminate.load()) {
 			std::this_thread::sleep_for(std::chrono::milliseconds{10});
 		}
@@ -42,6 +48,10 @@ public:
 		for (const std::unique_ptr<plugin>& plugin : plugins) {
 			plugin->stop();
 		}
+		if (executor::enabled()) {
+			// Queued tasks may refer to switchboard's subscriptions, so finish before they are destroyed.
+			pb.lookup_impl<executor>()->stop();
+		}
 		terminate.store(true);
 	}
 
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ILLIXR {
+
+	/**
+	 * @brief A single-writer, multi-reader ring of fixed-size slots in POSIX shared memory.
+	 *
+	 * This lets another process see a topic's events, encoded by their serializer (see
+	 * common/serializer.hpp). Each slot holds up to `event_size` bytes, and records how many of
+	 * them the event in it used, so variable-size events (e.g. camera frames) fit as long as they
+	 * are no bigger than that. There is no zero-copy path: each event is copied into its slot and
+	 * out again, which costs little for poses and IMU samples, but a copy per frame for images.
+	 *
+	 * If the writer restarts, it replaces the segment (see create), and readers which mapped the
+	 * old one must reopen it; see replaced().
+	 *
+	 * Proof of thread-safety (and process-safety):
+	 * - There is one writer per ring. It owns the segment, and is the only one to modify slots.
+	 * - Each slot is guarded by a seqlock: the writer makes its sequence odd, copies the event,
+	 *   then makes it even. A reader copies the slot out, and only keeps the copy if the sequence
+	 *   was the same (and even) before and after. So a reader never blocks the writer, and a slow
+	 *   reader is lapped (and told so) rather than slowing anyone down.
+	 * - Readers sleep on a futex on the header's published count. The writer only makes the
+	 *   wake-up syscall if a reader said it is waiting.
+	 */
+	class shm_ring {
+	public:
+		/**
+		 * @brief Creates the segment @p name, replacing any stale one, as its writer.
+		 */
+		static shm_ring create(const std::string& name, std::size_t type_hash, std::size_t event_size, std::size_t slot_count) {
+			shm_unlink(name.c_str());
+			int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+			if (fd < 0) {
+				throw std::system_error{errno, std::generic_category(), "shm_open " + name};
+			}
+			const std::size_t size = segment_size(event_size, slot_count);
+			if (ftruncate(fd, size) != 0) {
+				close(fd);
+				throw std::system_error{errno, std::generic_category(), "ftruncate " + name};
+			}
+			shm_ring ring {name, fd, size, true};
+			header* h = new (ring._m_base) header{};
+			h->type_hash = type_hash;
+			h->event_size = event_size;
+			h->slot_count = slot_count;
+			/* The segment is zero-filled, so every other field (and every slot's sequence) already starts at 0. */
+			h->magic.store(MAGIC, std::memory_order_release);
+			return ring;
+		}
+
+		/**
+		 * @brief Opens the existing segment @p name as a reader.
+		 *
+		 * @p event_size is the slot size the reader expects, or 0 to take the writer's (for variable-size events).
+		 *
+		 * @return false (leaving @p ring alone) if the writer has not created it yet.
+		 * @throws if the segment holds a different type, or is too small for the slots its header claims.
+		 */
+		static bool open(const std::string& name, std::size_t type_hash, std::size_t event_size, shm_ring& ring) {
+			int fd = shm_open(name.c_str(), O_RDWR, 0600);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat st;
+			if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < header_size()) {
+				close(fd);
+				return false;
+			}
+			shm_ring opened {name, fd, static_cast<std::size_t>(st.st_size), false};
+			const header* h = opened.get_header();
+			if (h->magic.load(std::memory_order_acquire) != MAGIC) {
+				return false;
+			}
+			if (h->type_hash != type_hash || (event_size != 0 && h->event_size != event_size)) {
+				throw std::runtime_error{"Shared-memory topic " + name + " holds a different type"};
+			}
+			/* The header is not to be trusted until it is known to describe the mapping, lest slots lie past its end. */
+			if (h->slot_count == 0 || h->event_size > opened._m_size
+				|| h->slot_count > (opened._m_size - header_size()) / slot_size(h->event_size)) {
+				throw std::runtime_error{"Shared-memory topic " + name + " is smaller than its header claims"};
+			}
+			ring = std::move(opened);
+			return true;
+		}
+
+		shm_ring() = default;
+
+		shm_ring(shm_ring&& other) noexcept {
+			*this = std::move(other);
+		}
+
+		shm_ring& operator=(shm_ring&& other) noexcept {
+			std::swap(_m_name, other._m_name);
+			std::swap(_m_base, other._m_base);
+			std::swap(_m_size, other._m_size);
+			std::swap(_m_owner, other._m_owner);
+			std::swap(_m_dev, other._m_dev);
+			std::swap(_m_ino, other._m_ino);
+			return *this;
+		}
+
+		~shm_ring() {
+			if (_m_base) {
+				munmap(_m_base, _m_size);
+				if (_m_owner) {
+					shm_unlink(_m_name.c_str());
+				}
+			}
+		}
+
+		/**
+		 * @brief Whether the name now refers to another segment than the one this reader mapped,
+		 * because a new writer created one (e.g. after the old writer crashed or restarted).
+		 *
+		 * If the name is gone (the writer exited), this keeps reading the old segment until a new one appears.
+		 */
+		bool replaced() const {
+			int fd = shm_open(_m_name.c_str(), O_RDONLY, 0);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat st;
+			const bool ok = fstat(fd, &st) == 0;
+			close(fd);
+			return ok && (st.st_dev != _m_dev || st.st_ino != _m_ino);
+		}
+
+		/**
+		 * @brief Publishes @p size bytes from @p event (by default, `event_size`). Writer only.
+		 */
+		void write(const void* event, std::size_t size = 0) {
+			if (size == 0) {
+				size = get_header()->event_size;
+			}
+			write_with(size, [event, size](void* slot) {
+				std::memcpy(slot, event, size);
+			});
+		}
+
+		/**
+		 * @brief Publishes an event of @p size bytes (at most `event_size`), which @p fill writes straight into the slot. Writer only.
+		 */
+		template <typename Fill>
+		void write_with(std::size_t size, Fill&& fill) {
+			header* h = get_header();
+			assert(size <= h->event_size);
+			const std::uint64_t seq = h->published.load(std::memory_order_relaxed);
+			slot_header* s = get_slot(seq);
+			s->seq.store(2 * seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			s->size.store(size, std::memory_order_relaxed);
+			fill(slot_data(s));
+			s->seq.store(2 * seq + 2, std::memory_order_release);
+			h->published.store(seq + 1, std::memory_order_release);
+			h->futex_word.fetch_add(1, std::memory_order_release);
+			if (h->waiters.load() > 0) {
+				syscall(SYS_futex, &h->futex_word, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+			}
+		}
+
+		enum class read_result {
+			/// @p out holds the event, and @p next was advanced.
+			ok,
+			/// Nothing new yet.
+			empty,
+			/// The writer overwrote the events this reader had not read; @p next was moved up to the oldest remaining one.
+			lapped,
+		};
+
+		/**
+		 * @brief Copies event number @p next into @p out, which must have room for `event_size` bytes,
+		 * and sets @p size to its size.
+		 */
+		read_result read(std::uint64_t& next, void* out, std::size_t& size) const {
+			const header* h = get_header();
+			const std::uint64_t published = h->published.load(std::memory_order_acquire);
+			if (next >= published) {
+				return read_result::empty;
+			}
+			if (published - next > h->slot_count) {
+				next = published - h->slot_count;
+				return read_result::lapped;
+			}
+			const slot_header* s = get_slot(next);
+			const std::uint64_t before = s->seq.load(std::memory_order_acquire);
+			if (before != 2 * next + 2) {
+				return skip_overwritten(next);
+			}
+			/* This may race with the writer; the sequence check below tells us whether it did. */
+			const std::size_t slot_used = std::min<std::size_t>(s->size.load(std::memory_order_relaxed), h->event_size);
+			std::memcpy(out, slot_data(s), slot_used);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (s->seq.load(std::memory_order_relaxed) != before) {
+				return skip_overwritten(next);
+			}
+			size = slot_used;
+			next++;
+			return read_result::ok;
+		}
+
+		/**
+		 * @brief Sleeps until more than @p next events have been published, or @p timeout passes.
+		 */
+		void wait(std::uint64_t next, std::chrono::nanoseconds timeout) const {
+			header* h = const_cast<header*>(get_header());
+			const std::uint32_t word = h->futex_word.load(std::memory_order_acquire);
+			h->waiters.fetch_add(1);
+			if (h->published.load() <= next) {
+				struct timespec ts;
+				ts.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(timeout).count();
+				ts.tv_nsec = (timeout - std::chrono::seconds{ts.tv_sec}).count();
+				/* Returns at once if the writer bumped futex_word since I read it. */
+				syscall(SYS_futex, &h->futex_word, FUTEX_WAIT, word, &ts, nullptr, 0);
+			}
+			h->waiters.fetch_sub(1);
+		}
+
+		std::size_t event_size() const {
+			return get_header()->event_size;
+		}
+
+		std::uint64_t published() const {
+			return get_header()->published.load(std::memory_order_acquire);
+		}
+
+	private:
+		static constexpr std::uint64_t MAGIC = 0x494c4c49585232ULL; // "ILLIXR2"
+
+		struct header {
+			std::atomic<std::uint64_t> magic;
+			std::size_t type_hash;
+			std::size_t event_size;
+			std::size_t slot_count;
+			std::atomic<std::uint64_t> published;
+			/* Bumped on every write. 32 bits, because that is what futex waits on. */
+			std::atomic<std::uint32_t> futex_word;
+			std::atomic<std::uint32_t> waiters;
+		};
+
+		/* Followed by event_size bytes of data, at data_offset(), of which the first `size` are the event. */
+		struct slot_header {
+			std::atomic<std::uint64_t> seq;
+			std::atomic<std::uint64_t> size;
+		};
+
+		static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shm_ring needs address-free atomics");
+		static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "shm_ring needs address-free atomics");
+
+		static std::size_t round_up(std::size_t size) {
+			const std::size_t align = alignof(std::max_align_t);
+			return (size + align - 1) / align * align;
+		}
+
+		static std::size_t data_offset() {
+			return round_up(sizeof(slot_header));
+		}
+
+		static std::size_t slot_size(std::size_t event_size) {
+			return data_offset() + round_up(event_size);
+		}
+
+		static std::size_t header_size() {
+			return round_up(sizeof(header));
+		}
+
+		static void* slot_data(slot_header* s) {
+			return reinterpret_cast<unsigned char*>(s) + data_offset();
+		}
+
+		static const void* slot_data(const slot_header* s) {
+			return reinterpret_cast<const unsigned char*>(s) + data_offset();
+		}
+
+		/* Slot next is being (or has been) overwritten; skip to the oldest slot which is not. */
+		read_result skip_overwritten(std::uint64_t& next) const {
+			const header* h = get_header();
+			const std::uint64_t published = h->published.load(std::memory_order_acquire);
+			const std::uint64_t oldest_safe = published + 1 > h->slot_count ? published + 1 - h->slot_count : 0;
+			next = std::max(next + 1, oldest_safe);
+			return read_result::lapped;
+		}
+
+		static std::size_t segment_size(std::size_t event_size, std::size_t slot_count) {
+			return header_size() + slot_size(event_size) * slot_count;
+		}
+
+		shm_ring(std::string name, int fd, std::size_t size, bool owner)
+			: _m_name{std::move(name)}
+			, _m_size{size}
+			, _m_owner{owner}
+		{
+			/* Identifies this segment, so that replaced() can tell when the name refers to another. */
+			struct stat st;
+			if (fstat(fd, &st) == 0) {
+				_m_dev = st.st_dev;
+				_m_ino = st.st_ino;
+			}
+			void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (base == MAP_FAILED) {
+				throw std::system_error{errno, std::generic_category(), "mmap " + _m_name};
+			}
+			_m_base = base;
+		}
+
+		header* get_header() {
+			return static_cast<header*>(_m_base);
+		}
+
+		const header* get_header() const {
+			return static_cast<const header*>(_m_base);
+		}
+
+		slot_header* get_slot(std::uint64_t seq) {
+			const header* h = get_header();
+			return reinterpret_cast<slot_header*>(static_cast<unsigned char*>(_m_base) + header_size() + slot_size(h->event_size) * (seq % h->slot_count));
+		}
+
+		const slot_header* get_slot(std::uint64_t seq) const {
+			const header* h = get_header();
+			return reinterpret_cast<const slot_header*>(static_cast<const unsigned char*>(_m_base) + header_size() + slot_size(h->event_size) * (seq % h->slot_count));
+		}
+
+		std::string _m_name;
+		void* _m_base = nullptr;
+		std::size_t _m_size = 0;
+		bool _m_owner = false;
+		dev_t _m_dev = 0;
+		ino_t _m_ino = 0;
+	};
+
+}
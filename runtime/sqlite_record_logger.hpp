@@ -9,6 +9,7 @@
 #include "concurrentqueue/blockingconcurrentqueue.hpp"
 #include "sqlite3pp/sqlite3pp.hpp"
 #include "common/record_logger.hpp"
+#include "common/thread_config.hpp"
 
 /**
  * There are many SQLite3 wrapper libraries.
@@ -20,6 +21,44 @@ namespace ILLIXR {
 
 class sqlite_thread {
 public:
+	/**
+	 * @brief How one column is stored: its SQL type, and how to bind its value from a record or from a record_batch.
+	 *
+	 * Looked up once per column when the table is registered, so inserting a row does not compare any typeids.
+	 */
+	struct column_binder {
+		const char* sql_type;
+		void (*bind_record)(sqlite3pp::command& cmd, int idx, const record& r, unsigned column);
+		void (*bind_batch)(sqlite3pp::command& cmd, int idx, const ILLIXR::record_batch& batch, std::size_t row, unsigned column);
+	};
+
+	static column_binder binder_for(const std::type_info& type) {
+		if (false) {
+		} else if (type == typeid(std::size_t)) {
+			return make_binder<std::size_t>("INTEGER");
+		} else if (type == typeid(bool)) {
+			return make_binder<bool>("INTEGER");
+		} else if (type == typeid(std::chrono::nanoseconds)) {
+			return make_binder<std::chrono::nanoseconds>("INTEGER");
+		} else if (type == typeid(std::chrono::high_resolution_clock::time_point)) {
+			return make_binder<std::chrono::high_resolution_clock::time_point>("INTEGER");
+		} else if (type == typeid(std::string)) {
+			return make_binder<std::string>("TEXT");
+		} else if (type == typeid(double)) {
+			return make_binder<double>("REAL");
+		} else {
+			throw std::runtime_error{std::string{"type "} + std::string{type.name()} + std::string{" not found"}};
+		}
+	}
+
+	std::vector<column_binder> prep_binders() {
+		std::vector<column_binder> ret;
+		for (unsigned i = 0; i < rh.get_columns(); ++i) {
+			ret.push_back(binder_for(rh.get_column_type(i)));
+		}
+		return ret;
+	}
+
 	sqlite3pp::database prep_db() {
 		if (!std::experimental::filesystem::exists(dir)) {
 			std::experimental::filesystem::create_directory(dir);
@@ -35,23 +74,7 @@ public:
 
 		std::string create_table_string = std::string{"CREATE TABLE "} + table_name + std::string{"("};
 		for (unsigned i = 0; i < rh.get_columns(); ++i) {
-			create_table_string += rh.get_column_name(i) + std::string{" "};
-			if (false) {
-			} else if (rh.get_column_type(i) == typeid(std::size_t)) {
-				create_table_string += std::string{"INTEGER"};
-			} else if (rh.get_column_type(i) == typeid(bool)) {
-				create_table_string += std::string{"INTEGER"};
-			} else if (rh.get_column_type(i) == typeid(std::chrono::nanoseconds)) {
-				create_table_string += std::string{"INTEGER"};
-			} else if (rh.get_column_type(i) == typeid(std::chrono::high_resolution_clock::time_point)) {
-				create_table_string += std::string{"INTEGER"};
-			} else if (rh.get_column_type(i) == typeid(std::string)) {
-				create_table_string += std::string{"TEXT"};
-			} else if (rh.get_column_type(i) == typeid(double)) {
-				create_table_string += std::string{"REAL"};
-			} else {
-				throw std::runtime_error{std::string{"type "} + std::string{rh.get_column_type(i).name()} + std::string{" not found"}};
-			}
+			create_table_string += rh.get_column_name(i) + std::string{" "} + binders[i].sql_type;
 			create_table_string += std::string{", "};
 		}
 		create_table_string.erase(create_table_string.size() - 2);
@@ -70,6 +93,7 @@ public:
 	sqlite_thread(const record_header& rh_)
 		: rh{rh_}
 		, table_name{rh.get_name()}
+		, binders{prep_binders()}
 		, db{prep_db()}
 		, insert_str{prep_insert_str()}
 		, insert_cmd{db, insert_str.c_str()}
@@ -81,6 +105,7 @@ public:
 		std::vector<record> record_batch {max_record_batch_size};
 		std::size_t actual_batch_size;
 
+		thread_config::from_env("sqlite").apply("sql_" + table_name);
 		std::cout << "thread," << std::this_thread::get_id() << ",sqlite thread," << table_name << std::endl;
 
 		std::size_t processed = 0;
@@ -104,47 +129,47 @@ public:
 			process(record_batch, actual_batch_size);
 			post_processed += actual_batch_size;
 		}
+		std::unique_ptr<const ILLIXR::record_batch> typed_batch;
+		while (typed_batch_queue.try_dequeue(typed_batch)) {
+			process(*typed_batch);
+			post_processed += typed_batch->size();
+		}
 		std::cerr << "Drained " << table_name << " (sqlite); " << post_processed << " / " << (processed + post_processed) << " done post real time" << std::endl;
 	}
 
 	void process(const std::vector<record>& record_batch, std::size_t batch_size) {
 		sqlite3pp::transaction xct{db};
 		for (std::size_t i = 0; i < batch_size; ++i) {
-			// TODO(performance): reuse the sqlite3pp statement
-			// This currently has to be 'reinterpreted' for every iteration.
-			sqlite3pp::command cmd{db, insert_str.c_str()};
 			const record& r = record_batch[i];
 			for (unsigned i = 0; i < rh.get_columns(); ++i) {
-				/*
-				  If you get a `std::bad_any_cast` here, make sure the user didn't lie about record.get_record_header().
-				  The types there should be the same as those in record.get_values().
-				*/
-				if (false) {
-				} else if (rh.get_column_type(i) == typeid(std::size_t)) {
-					cmd.bind(i+1, static_cast<long long>(r.get_value<std::size_t>(i)));
-				} else if (rh.get_column_type(i) == typeid(bool)) {
-					cmd.bind(i+1, static_cast<long long>(r.get_value<bool>(i)));
-				} else if (rh.get_column_type(i) == typeid(double)) {
-					cmd.bind(i+1, r.get_value<double>(i));
-				} else if (rh.get_column_type(i) == typeid(std::chrono::nanoseconds)) {
-					cmd.bind(i+1, static_cast<long long>(r.get_value<std::chrono::nanoseconds>(i).count()));
-				} else if (rh.get_column_type(i) == typeid(std::chrono::high_resolution_clock::time_point)) {
-					auto val = r.get_value<std::chrono::high_resolution_clock::time_point>(i).time_since_epoch();
-					cmd.bind(i+1, static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(val).count()));
-				} else if (rh.get_column_type(i) == typeid(std::string)) {
-					// r.get_value<std::string>(i) returns a std::string temporary
-					// c_str() returns a pointer into that std::string temporary
-					// Therefore, need to copy.
-					cmd.bind(i+1, r.get_value<std::string>(i).c_str(), sqlite3pp::copy);
-				} else {
-					throw std::runtime_error{std::string{"type "} + std::string{rh.get_column_type(i).name()} + std::string{" not implemented"}};
-				}
+				binders[i].bind_record(insert_cmd, i+1, r, i);
 			}
-			cmd.execute();
+			insert_cmd.execute();
+			insert_cmd.reset();
 		}
 		xct.commit();
 	}
 
+	/**
+	 * @brief Inserts the rows of @p batch, reading each value straight out of its column.
+	 */
+	void process(const ILLIXR::record_batch& batch) {
+		assert(batch.get_record_header().get_id() == rh.get_id());
+		sqlite3pp::transaction xct{db};
+		for (std::size_t row = 0; row < batch.size(); ++row) {
+			for (unsigned i = 0; i < rh.get_columns(); ++i) {
+				binders[i].bind_batch(insert_cmd, i+1, batch, row, i);
+			}
+			insert_cmd.execute();
+			insert_cmd.reset();
+		}
+		xct.commit();
+	}
+
+	void put_queue(std::unique_ptr<const ILLIXR::record_batch> batch) {
+		typed_batch_queue.enqueue(std::move(batch));
+	}
+
 	void put_queue(const std::vector<record>& buffer_in) {
 		queue.enqueue_bulk(buffer_in.begin(), buffer_in.size());
 	}
@@ -159,13 +184,61 @@ public:
 	}
 
 private:
+	template <typename T>
+	static column_binder make_binder(const char* sql_type) {
+		return column_binder{
+			sql_type,
+			[](sqlite3pp::command& cmd, int idx, const record& r, unsigned column) {
+				/*
+				  If you get a `std::bad_any_cast` here, make sure the user didn't lie about record.get_record_header().
+				  The types there should be the same as those in record.get_values().
+				*/
+				// r.get_value returns a temporary, which a string must be copied out of.
+				bind_value(cmd, idx, r.get_value<T>(column), sqlite3pp::copy);
+			},
+			[](sqlite3pp::command& cmd, int idx, const ILLIXR::record_batch& batch, std::size_t row, unsigned column) {
+				// The batch outlives the statement's execution, so a string need not be copied.
+				bind_value(cmd, idx, batch.get_value<T>(row, column), sqlite3pp::nocopy);
+			},
+		};
+	}
+
+	static void bind_value(sqlite3pp::command& cmd, int idx, std::size_t value, sqlite3pp::copy_semantic) {
+		cmd.bind(idx, static_cast<long long>(value));
+	}
+
+	static void bind_value(sqlite3pp::command& cmd, int idx, bool value, sqlite3pp::copy_semantic) {
+		cmd.bind(idx, static_cast<long long>(value));
+	}
+
+	static void bind_value(sqlite3pp::command& cmd, int idx, double value, sqlite3pp::copy_semantic) {
+		cmd.bind(idx, value);
+	}
+
+	static void bind_value(sqlite3pp::command& cmd, int idx, std::chrono::nanoseconds value, sqlite3pp::copy_semantic) {
+		cmd.bind(idx, static_cast<long long>(value.count()));
+	}
+
+	static void bind_value(sqlite3pp::command& cmd, int idx, std::chrono::high_resolution_clock::time_point value, sqlite3pp::copy_semantic) {
+		cmd.bind(idx, static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(value.time_since_epoch()).count()));
+	}
+
+	static void bind_value(sqlite3pp::command& cmd, int idx, const std::string& value, sqlite3pp::copy_semantic fcopy) {
+		cmd.bind(idx, value.c_str(), fcopy);
+	}
+
 	static const std::experimental::filesystem::path dir;
 	const record_header& rh;
 	std::string table_name;
+	/* One per column; before db and insert_str, which are prepared from them. */
+	std::vector<column_binder> binders;
 	sqlite3pp::database db;
 	std::string insert_str;
+	/* Prepared once, and reset after each row. */
 	sqlite3pp::command insert_cmd;
 	moodycamel::BlockingConcurrentQueue<record> queue;
+	/* Batches from typed_record_coalescer, which are inserted without boxing their values into records. */
+	moodycamel::ConcurrentQueue<std::unique_ptr<const ILLIXR::record_batch>> typed_batch_queue;
 	std::atomic<bool> terminate {false};
 	std::thread thread;
 };
@@ -174,8 +247,7 @@ const std::experimental::filesystem::path sqlite_thread::dir {"metrics"};
 
 class sqlite_record_logger : public record_logger {
 private:
-	sqlite_thread& get_sqlite_thread(const record& r) {
-		const record_header& rh = r.get_record_header();
+	sqlite_thread& get_sqlite_thread(const record_header& rh) {
 		auto result = registered_tables.find(rh.get_id());
 		if (result != registered_tables.cend()) {
 			return result->second;
@@ -189,12 +261,19 @@ private:
 protected:
 	virtual void log(const std::vector<record>& r) override {
 		if (!r.empty()) {
-			get_sqlite_thread(r[0]).put_queue(r);
+			get_sqlite_thread(r[0].get_record_header()).put_queue(r);
 		}
 	}
 
 	virtual void log(const record& r) override {
-		get_sqlite_thread(r).put_queue(r);
+		get_sqlite_thread(r.get_record_header()).put_queue(r);
+	}
+
+	virtual void log(std::unique_ptr<const record_batch> batch) override {
+		if (batch->size() > 0) {
+			sqlite_thread& thread = get_sqlite_thread(batch->get_record_header());
+			thread.put_queue(std::move(batch));
+		}
 	}
 
 private:
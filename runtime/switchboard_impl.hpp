@@ -1,25 +1,55 @@
 #include "common/switchboard.hpp"
 #include "common/data_format.hpp"
+#include "common/record_logger.hpp"
+#include "common/thread_config.hpp"
+#include "common/executor.hpp"
+#include "common/perf_counters.hpp"
+#include <algorithm>
 #include <atomic>
 #include <vector>
+#include <thread>
+#include <unordered_map>
 #include <iostream>
 #include <cassert>
 #include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <new>
+#include <limits>
+#include <unordered_set>
+#include <sstream>
+#include <optional>
+#include <cstring>
+#include <utility>
+#include <pthread.h>
+#include <sched.h>
 
+#include "shm_ring.hpp"
+#include "event_log.hpp"
 #include "concurrentqueue/blockingconcurrentqueue.hpp"
-template <typename T>
-using queue = moodycamel::BlockingConcurrentQueue<T>;
 
 /*
 Proof of thread-safety:
 - Since all instance members are private, proving each method is datarace-free implies the class is.
     - I prove this by showing every access is guarded by a lock, implemented atomically, or uses concurrent primitives (AKA the concurrentqueue.hpp implementatoin).
-- All code in this module acquires _m_registry_lock before _m_callbacks_lock, and does not call any external code which could acquire a lock, therefore this is deadlock-free.
-- (Bonus) none of the locks are contended in steady-state.
+- All code in this module acquires _m_registry_lock before _m_callbacks_lock before a subscription's _m_ring_lock, and does not call any external code which could acquire a lock, therefore this is deadlock-free.
+    - The exception is overflow_policy::block, where put() waits for a worker. A callback which publishes to a full ring served by its own worker will deadlock; this is documented on the policy.
+- (Bonus) none of the locks are held while a callback runs, and they are only held briefly in steady-state.
+
+Ordering:
+- Each subscription is pinned to one worker's queue, so it sees its topic's events in publication order (but see caveat on put()).
+- Different subscriptions may run in parallel, on different workers.
+- A worker serves its queued realtime subscriptions before normal ones, and normal ones before background ones (see dispatch_queue).
 
 Caveat:
-- See caveat on invoke_callbacks()
 - See caveat on put()
+
+Memory:
+- Events are held by shared_ptr: one reference in _m_latest, one per subscription ring slot, and one per outstanding reader.
+- Each subscription's ring is bounded (see queue_policy), so a slow callback cannot grow memory without bound.
+- When the last reference drops (in whichever thread that happens), the event is destroyed, and if it came from writer::allocate(), its block returns to the topic's slab_pool.
 */
 
 namespace ILLIXR {
@@ -30,12 +60,34 @@ namespace ILLIXR {
 		{"cpu_time_stop" , typeid(std::chrono::nanoseconds)},
 		{"wall_time_start", typeid(std::chrono::high_resolution_clock::time_point)},
 		{"wall_time_stop" , typeid(std::chrono::high_resolution_clock::time_point)},
+		/* From perf_counters (0 unless ILLIXR_PERF_COUNTERS=y). */
+		{"cycles", typeid(std::size_t)},
+		{"instructions", typeid(std::size_t)},
+		{"cache_misses", typeid(std::size_t)},
+		{"context_switches", typeid(std::size_t)},
 	}};
+	/* Its column types, in order. */
+	typedef typed_record_coalescer<
+		std::size_t, std::size_t,
+		std::chrono::nanoseconds, std::chrono::nanoseconds,
+		std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point,
+		std::size_t, std::size_t, std::size_t, std::size_t
+	> __switchboard_callback_coalescer;
 
 	const record_header __switchboard_topic_stop_header {"switchboard_topic_stop", {
 		{"topic_name", typeid(std::string)},
 		{"processed", typeid(std::size_t)},
 		{"unprocessed", typeid(std::size_t)},
+		{"dropped_oldest", typeid(std::size_t)},
+		{"dropped_newest", typeid(std::size_t)},
+	}};
+
+	const record_header __switchboard_trace_header {"switchboard_trace", {
+		{"topic_name", typeid(std::string)},
+		{"trace_id", typeid(std::size_t)},
+		{"parent_topic_name", typeid(std::string)},
+		{"hop_latency", typeid(std::chrono::nanoseconds)},
+		{"origin_latency", typeid(std::chrono::nanoseconds)},
 	}};
 
 	const record_header __switchboard_check_queues_header {"switchboard_check_queues", {
@@ -45,93 +97,1037 @@ namespace ILLIXR {
 		{"wall_time_start", typeid(std::chrono::high_resolution_clock::time_point)},
 		{"wall_time_stop" , typeid(std::chrono::high_resolution_clock::time_point)},
 	}};
+	typedef typed_record_coalescer<
+		std::size_t,
+		std::chrono::nanoseconds, std::chrono::nanoseconds,
+		std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point
+	> __switchboard_check_queues_coalescer;
+
+	/**
+	 * @brief A free-list of equally-sized blocks, one per topic.
+	 *
+	 * Every allocation on a topic comes from `std::allocate_shared<event>`, so after the first one,
+	 * every request has the same size. Freed blocks are kept on a LIFO stack, so the next
+	 * `allocate()` gets the block which is most likely still in cache.
+	 */
+	class slab_pool : public event_pool {
+	public:
+		virtual void* allocate(std::size_t size, std::size_t align) override {
+			/*
+			  Proof of thread-safety:
+			  - All accesses to _m_free_list, _m_block_size, and _m_block_align occur after acquiring _m_free_list_lock.
+			  - The lock is only contended if a writer allocates while a reader drops the last reference to an old event.
+			 */
+			{
+				const std::lock_guard<std::mutex> lock{_m_free_list_lock};
+				if (_m_block_size == 0) {
+					_m_block_size = size;
+					_m_block_align = align;
+				}
+				if (size == _m_block_size && align == _m_block_align && !_m_free_list.empty()) {
+					void* block = _m_free_list.back();
+					_m_free_list.pop_back();
+					return block;
+				}
+			}
+			return ::operator new(size, std::align_val_t{align});
+		}
+
+		virtual void deallocate(void* block, std::size_t size, std::size_t align) noexcept override {
+			{
+				const std::lock_guard<std::mutex> lock{_m_free_list_lock};
+				if (size == _m_block_size && align == _m_block_align && _m_free_list.size() < MAX_FREE_BLOCKS) {
+					_m_free_list.push_back(block);
+					return;
+				}
+			}
+			::operator delete(block, std::align_val_t{align});
+		}
+
+		virtual ~slab_pool() override {
+			/* No need for thread-safety: the last shared_ptr to this pool is gone. */
+			for (void* block : _m_free_list) {
+				::operator delete(block, std::align_val_t{_m_block_align});
+			}
+		}
+
+	private:
+		/* Bounds the memory retained after a burst of events. */
+		static constexpr std::size_t MAX_FREE_BLOCKS = 64;
+
+		std::mutex _m_free_list_lock;
+		std::vector<void*> _m_free_list;
+		std::size_t _m_block_size = 0;
+		std::size_t _m_block_align = 0;
+	};
+
+	/**
+	 * @brief What switchboard knows about where an event came from. Stamped by put().
+	 *
+	 * A trace starts at an event published with no cause, e.g. a sensor sample. Every event
+	 * published because of it carries the same trace id and origin time, so the delay between
+	 * stages (a "hop") and from the sensor (the "origin") can be measured.
+	 */
+	struct event_stamp {
+		/* 0 means no trace. */
+		std::uint64_t trace_id = 0;
+		std::chrono::steady_clock::time_point origin;
+		std::chrono::steady_clock::time_point published;
+		/* Interned by trace_context::intern, so it outlives the topic. */
+		const std::string* topic_name = nullptr;
+	};
+
+	/**
+	 * @brief The event which the current thread is working on behalf of.
+	 *
+	 * A callback works on behalf of the event it was called with. Reads through reader_latest and
+	 * reader adopt the event read, if it comes from a newer origin than the current one: a plugin
+	 * which combines several inputs (e.g. vsync and imu_raw) is charged from its freshest input.
+	 * put() continues the current trace (or starts a new one), and then forgets what was read, so
+	 * that a threadloop's next iteration starts afresh.
+	 *
+	 * Thread-local, and only accessed from this file, so it is one variable however many
+	 * plugins are loaded.
+	 */
+	class trace_context {
+	public:
+		static event_stamp& current() {
+			thread_local event_stamp stamp;
+			return stamp;
+		}
+
+		/* The event of the callback running on this thread, if any. */
+		static event_stamp& callback() {
+			thread_local event_stamp stamp;
+			return stamp;
+		}
+
+		static void adopt(const event_stamp& stamp) {
+			event_stamp& cur = current();
+			if (stamp.trace_id != 0 && (cur.trace_id == 0 || stamp.origin >= cur.origin)) {
+				cur = stamp;
+			}
+		}
+
+		static void enter_callback(const event_stamp& stamp) {
+			callback() = stamp;
+			current() = stamp;
+		}
+
+		static void reset() {
+			current() = callback();
+		}
+
+		/* Topic names are few, and are kept forever, since a thread may still hold a stamp
+		   naming a topic whose switchboard is gone. */
+		static const std::string* intern(const std::string& name) {
+			static std::mutex lock;
+			static std::unordered_set<std::string> names;
+			const std::lock_guard<std::mutex> guard{lock};
+			return &*names.insert(name).first;
+		}
+
+		static std::uint64_t new_trace_id() {
+			static std::atomic<std::uint64_t> next {1};
+			return next++;
+		}
+	};
+
+	/**
+	 * @brief An event as stored in a topic's _m_latest: the event, plus its stamp.
+	 */
+	struct stamped_event {
+		std::shared_ptr<const void> event;
+		event_stamp stamp;
+	};
+
+	class subscription;
+
+	/**
+	 * @brief A switchboard worker's queue. Each item means: deliver the next queued event of this subscription.
+	 *
+	 * The event itself waits in the subscription's ring, so that the ring can enforce its bound.
+	 * Each subscription counts the tokens queued for it (see subscription::idle), and its topic only
+	 * frees it once there are none, so the raw pointer stays valid.
+	 *
+	 * There is one FIFO per priority_class, and the worker drains higher classes first. A running
+	 * callback is never preempted, so a realtime event can still wait for one lower-class callback.
+	 *
+	 * In executor mode (see common/executor.hpp), there is no worker. Instead, each subscription
+	 * counts its own tokens, and while it has any, one task on the executor redeems them. So a
+	 * subscription's events are still delivered in order, one at a time. The executor has no
+	 * notion of priority, so priority classes only matter to the dedicated realtime workers.
+	 *
+	 * Proof of thread-safety:
+	 * - Many writers enqueue; only the owning worker dequeues.
+	 * - Each item is enqueued before its token is signalled. So once the worker takes a token,
+	 *   some FIFO holds an item which nobody else can take (same argument as BlockingConcurrentQueue).
+	 * - In executor mode, a subscription's token count is atomic, and only the enqueue which raises
+	 *   it from 0 (or the task which leaves it above 0) submits a task. So there is at most one task
+	 *   per subscription.
+	 */
+	class dispatch_queue {
+	public:
+		dispatch_queue() = default;
+
+		explicit dispatch_queue(std::shared_ptr<executor> exec)
+			: _m_executor{std::move(exec)}
+		{ }
+
+		/**
+		 * @brief Queues @p count tokens for @p sub, waking the worker once.
+		 */
+		bool enqueue(subscription* sub, priority_class priority, std::size_t count = 1);
+
+		bool wait_dequeue_timed(subscription*& sub, std::int64_t timeout_usecs) {
+			if (!_m_tokens.wait(timeout_usecs)) {
+				return false;
+			}
+			while (true) {
+				for (moodycamel::ConcurrentQueue<subscription*>& fifo : _m_fifos) {
+					if (fifo.try_dequeue(sub)) {
+						return true;
+					}
+				}
+			}
+		}
+
+	private:
+		/* The tokens are all the same pointer, so enqueue_bulk reads them from this rather than from an array. */
+		struct repeat_iterator {
+			subscription* sub;
+
+			subscription* operator*() const {
+				return sub;
+			}
+
+			repeat_iterator& operator++() {
+				return *this;
+			}
+
+			repeat_iterator operator++(int) {
+				return *this;
+			}
+		};
+
+		/* Executor mode: how many of a subscription's events one task delivers, before yielding the worker. */
+		static constexpr std::size_t DRAIN_BATCH = 16;
+
+		bool push(subscription* sub, priority_class priority, std::size_t count) {
+			moodycamel::ConcurrentQueue<subscription*>& fifo = _m_fifos[static_cast<std::size_t>(priority)];
+			const bool ret = count == 1 ? fifo.enqueue(sub) : fifo.enqueue_bulk(repeat_iterator{sub}, count);
+			_m_tokens.signal(static_cast<moodycamel::LightweightSemaphore::ssize_t>(count));
+			return ret;
+		}
+
+		void post(subscription* sub, std::size_t count);
+		void submit_drain(subscription* sub);
+
+		std::array<moodycamel::ConcurrentQueue<subscription*>, 3> _m_fifos;
+		moodycamel::LightweightSemaphore _m_tokens;
+		const std::shared_ptr<executor> _m_executor;
+	};
+
+	/**
+	 * @brief A callback registered through `schedule()`.
+	 *
+	 * Each subscription is pinned to one worker's queue, so its events are delivered in order,
+	 * one at a time. Different subscriptions (even on the same topic) can run in parallel.
+	 *
+	 * Pending events wait in a ring of `queue_policy::capacity` slots. The worker's queue holds
+	 * one token per occupied slot.
+	 *
+	 * A batch subscription (from `schedule_batch()`) instead holds at most one token: each
+	 * invocation drains up to _m_max_batch events, and re-queues the subscription if more remain.
+	 * So events which pile up while the callback runs are delivered together.
+	 */
+	class subscription {
+	public:
+		typedef std::function<void(const std::shared_ptr<const void>&)> callback_type;
+		typedef std::function<void(const std::shared_ptr<const void>*, std::size_t)> batch_callback_type;
+
+		subscription(std::shared_ptr<record_logger> record_logger_, std::size_t component_id, callback_type callback, dispatch_queue& queue, queue_policy policy)
+			: subscription{record_logger_, component_id, callback, nullptr, 0, queue, policy}
+		{ }
+
+		subscription(std::shared_ptr<record_logger> record_logger_, std::size_t component_id, batch_callback_type callback, std::size_t max_batch, dispatch_queue& queue, queue_policy policy)
+			: subscription{record_logger_, component_id, nullptr, callback, std::max(std::size_t{1}, max_batch), queue, policy}
+		{ }
+
+		/**
+		 * @brief Queue @p count events, applying the overflow policy whenever the ring is full.
+		 *
+		 * All of them get the same @p stamp, since they are published together.
+		 *
+		 * @return how many tokens the caller owes the worker.
+		 */
+		std::size_t push(const std::shared_ptr<const void>* events, std::size_t count, const event_stamp& stamp) {
+			/*
+			 * Proof of thread-safety:
+			 * - Reads and modifies the ring, counters, and _m_token_outstanding after acquiring _m_ring_lock.
+			 * - The caller must not hold any other lock, because overflow_policy::block may wait here
+			 *   until the worker pops.
+			 */
+			std::unique_lock<std::mutex> lock{_m_ring_lock};
+			std::size_t filled = 0;
+			for (std::size_t i = 0; i < count; ++i) {
+				if (_m_size == _m_ring.size() && !_m_closed) {
+					switch (_m_overflow) {
+					case overflow_policy::block:
+						_m_not_full.wait(lock, [this] { return _m_size < _m_ring.size() || _m_closed; });
+						break;
+					case overflow_policy::drop_oldest:
+						/* Overwrite the oldest slot in place. Its token is still queued, and now refers to the next-oldest event. */
+						_m_ring[_m_head] = pending{events[i], stamp};
+						_m_head = (_m_head + 1) % _m_ring.size();
+						_m_dropped_oldest++;
+						continue;
+					case overflow_policy::drop_newest:
+						_m_dropped_newest++;
+						continue;
+					}
+				}
+				if (_m_closed) {
+					_m_unprocessed += count - i;
+					break;
+				}
+				_m_ring[(_m_head + _m_size) % _m_ring.size()] = pending{events[i], stamp};
+				_m_size++;
+				filled++;
+			}
+			if (_m_max_batch == 0) {
+				return filled;
+			}
+			if (_m_size > 0 && !_m_token_outstanding) {
+				_m_token_outstanding = true;
+				return 1;
+			}
+			return 0;
+		}
+
+		/**
+		 * @brief Take the oldest queued event (the caller redeems a token).
+		 *
+		 * Returns null if close() discarded the event which the token was for.
+		 */
+		std::shared_ptr<const void> pop(event_stamp& stamp) {
+			std::shared_ptr<const void> event;
+			{
+				const std::lock_guard<std::mutex> lock{_m_ring_lock};
+				if (_m_size == 0) {
+					assert(_m_closed);
+					return event;
+				}
+				event = std::move(_m_ring[_m_head].event);
+				stamp = _m_ring[_m_head].stamp;
+				_m_head = (_m_head + 1) % _m_ring.size();
+				_m_size--;
+			}
+			_m_not_full.notify_one();
+			return event;
+		}
+
+		/**
+		 * @brief Stop accepting events, release blocked writers, and count what was never delivered.
+		 *
+		 * Once this returns, the callback will not be started again (but it may still be running).
+		 */
+		void close() {
+			{
+				const std::lock_guard<std::mutex> lock{_m_ring_lock};
+				_m_closed = true;
+				for (; _m_size > 0; _m_size--) {
+					_m_ring[_m_head].event.reset();
+					_m_head = (_m_head + 1) % _m_ring.size();
+					_m_unprocessed++;
+				}
+			}
+			_m_not_full.notify_all();
+		}
+
+		void invoke() {
+			if (_m_max_batch > 0) {
+				invoke_batch();
+				return;
+			}
+			/*
+			 * Proof of thread-safety:
+			 * - Only the worker owning _m_queue (or, in executor mode, this subscription's one task) calls this, so _m_cb_log is not shared.
+			 * - Modifies _m_iteration_no and _m_latency_us using atomics, since stats() reads them live.
+			 * - The event is released before returning, rather than held until the next one arrives.
+			 * - Sets this thread's trace_context, which is thread-local.
+			 */
+			event_stamp stamp;
+			std::shared_ptr<const void> event = pop(stamp);
+			if (!event) {
+				return;
+			}
+			const perf_counters& counters = perf_counters::this_thread();
+			const perf_counters::sample counters_start = counters.read();
+			auto cb_start_cpu_time  = thread_cpu_time();
+			auto cb_start_wall_time = std::chrono::high_resolution_clock::now();
+			/* Whatever the callback publishes was caused by this event. */
+			trace_context::enter_callback(stamp);
+			_m_callback(event);
+			const perf_counters::sample counted = counters.read() - counters_start;
+			trace_context::enter_callback(event_stamp{});
+			event.reset();
+			record_latency(std::chrono::steady_clock::now() - stamp.published);
+			_m_cb_log.log(
+				_m_component_id,
+				_m_iteration_no.load(),
+				cb_start_cpu_time,
+				thread_cpu_time(),
+				cb_start_wall_time,
+				std::chrono::high_resolution_clock::now(),
+				std::size_t(counted.cycles),
+				std::size_t(counted.instructions),
+				std::size_t(counted.cache_misses),
+				std::size_t(counted.context_switches)
+			);
+			_m_iteration_no++;
+		}
+
+		/**
+		 * @brief Calls the batch callback with the oldest queued events (the caller redeems the token).
+		 */
+		void invoke_batch() {
+			/*
+			 * Proof of thread-safety:
+			 * - Only the worker owning _m_queue (or, in executor mode, this subscription's one task) calls this, so _m_batch, _m_batch_stamps, and _m_cb_log are not shared.
+			 * - Takes the events under _m_ring_lock. If some remain, the token stays outstanding, and is
+			 *   re-queued to the same worker, so batches are still delivered in order, one at a time.
+			 * - Otherwise, same as invoke.
+			 */
+			_m_batch.clear();
+			_m_batch_stamps.clear();
+			bool more;
+			{
+				const std::lock_guard<std::mutex> lock{_m_ring_lock};
+				const std::size_t count = std::min(_m_size, _m_max_batch);
+				for (std::size_t i = 0; i < count; ++i) {
+					_m_batch.push_back(std::move(_m_ring[_m_head].event));
+					_m_batch_stamps.push_back(_m_ring[_m_head].stamp);
+					_m_head = (_m_head + 1) % _m_ring.size();
+				}
+				_m_size -= count;
+				more = _m_size > 0;
+				_m_token_outstanding = more;
+			}
+			if (_m_batch.empty()) {
+				/* close() discarded them. */
+				return;
+			}
+			_m_not_full.notify_all();
+			if (more) {
+				[[maybe_unused]] bool ret = _m_queue.enqueue(this, _m_priority);
+				assert(ret);
+			}
+
+			const perf_counters& counters = perf_counters::this_thread();
+			const perf_counters::sample counters_start = counters.read();
+			auto cb_start_cpu_time  = thread_cpu_time();
+			auto cb_start_wall_time = std::chrono::high_resolution_clock::now();
+			/* Charge whatever the callback publishes to its freshest input. */
+			trace_context::enter_callback(_m_batch_stamps.back());
+			_m_batch_callback(_m_batch.data(), _m_batch.size());
+			const perf_counters::sample counted = counters.read() - counters_start;
+			trace_context::enter_callback(event_stamp{});
+			/* Release the events now; the vector keeps its capacity. */
+			const std::size_t count = _m_batch.size();
+			_m_batch.clear();
+			const auto now = std::chrono::steady_clock::now();
+			for (const event_stamp& stamp : _m_batch_stamps) {
+				record_latency(now - stamp.published);
+			}
+			_m_cb_log.log(
+				_m_component_id,
+				_m_iteration_no.load(),
+				cb_start_cpu_time,
+				thread_cpu_time(),
+				cb_start_wall_time,
+				std::chrono::high_resolution_clock::now(),
+				std::size_t(counted.cycles),
+				std::size_t(counted.instructions),
+				std::size_t(counted.cache_misses),
+				std::size_t(counted.context_switches)
+			);
+			/* Counts events rather than calls, since stats() reports it as processed. */
+			_m_iteration_no += count;
+		}
+
+		dispatch_queue& get_queue() {
+			return _m_queue;
+		}
+
+		/**
+		 * @brief Worker mode: counts @p count more tokens, before they are queued.
+		 */
+		void hold(std::size_t count) {
+			_m_queued += count;
+		}
+
+		/**
+		 * @brief Worker mode: called once invoke() has returned. The worker must not touch this afterwards.
+		 */
+		void redeem() {
+			_m_queued--;
+		}
+
+		/**
+		 * @brief Whether no token for this is queued or being redeemed, in either mode.
+		 *
+		 * Once a closed subscription is idle, and no writer can still reach it, nothing else will
+		 * queue a token for it (see topic::reclaim).
+		 */
+		bool idle() const {
+			return _m_queued.load() == 0 && _m_posted.load() == 0;
+		}
+
+		bool closed() {
+			const std::lock_guard<std::mutex> lock{_m_ring_lock};
+			return _m_closed;
+		}
+
+		/**
+		 * @brief Executor mode: counts @p count more tokens.
+		 *
+		 * @return whether the caller must submit a task to redeem them (see dispatch_queue).
+		 */
+		bool post(std::size_t count) {
+			return _m_posted.fetch_add(count) == 0;
+		}
+
+		/**
+		 * @brief Executor mode: redeems up to @p max tokens, one invoke() each.
+		 *
+		 * @return whether tokens remain, in which case the caller must submit another task.
+		 */
+		bool drain(std::size_t max) {
+			for (std::size_t i = 0; i < max; ++i) {
+				invoke();
+				if (_m_posted.fetch_sub(1) == 1) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		priority_class priority() const {
+			return _m_priority;
+		}
+
+		std::size_t component_id() const {
+			return _m_component_id;
+		}
+
+		/**
+		 * @brief Adds this subscription's counters to @p stats.
+		 */
+		void add_stats(topic_stats& stats) {
+			/*
+			 * Proof of thread-safety:
+			 * - Reads the ring's counters after acquiring _m_ring_lock.
+			 * - Reads _m_iteration_no and _m_latency_us using atomics. The snapshot may be slightly
+			 *   inconsistent (e.g. one delivery counted in processed but not yet in the histogram).
+			 */
+			{
+				const std::lock_guard<std::mutex> lock{_m_ring_lock};
+				stats.queue_depth += _m_size;
+				stats.unprocessed += _m_unprocessed;
+				stats.dropped_oldest += _m_dropped_oldest;
+				stats.dropped_newest += _m_dropped_newest;
+			}
+			stats.processed += _m_iteration_no.load();
+			for (std::size_t i = 0; i < topic_stats::LATENCY_BUCKETS; ++i) {
+				stats.callback_latency_us[i] += _m_latency_us[i].load(std::memory_order_relaxed);
+			}
+		}
+
+	private:
+		subscription(std::shared_ptr<record_logger> record_logger_, std::size_t component_id, callback_type callback, batch_callback_type batch_callback, std::size_t max_batch, dispatch_queue& queue, queue_policy policy)
+			: _m_component_id{component_id}
+			, _m_callback{callback}
+			, _m_batch_callback{batch_callback}
+			, _m_max_batch{max_batch}
+			, _m_queue{queue}
+			, _m_priority{policy.priority}
+			, _m_overflow{policy.overflow}
+			, _m_ring(std::max(std::size_t{1}, policy.capacity))
+			, _m_cb_log{record_logger_, __switchboard_callback_header}
+		{
+			for (auto& bucket : _m_latency_us) {
+				bucket.store(0);
+			}
+			_m_batch.reserve(_m_max_batch);
+			_m_batch_stamps.reserve(_m_max_batch);
+		}
+
+		void record_latency(std::chrono::steady_clock::duration latency) {
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+			std::size_t bucket = 0;
+			for (; us > 1 && bucket + 1 < topic_stats::LATENCY_BUCKETS; us >>= 1) {
+				bucket++;
+			}
+			_m_latency_us[bucket].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		struct pending {
+			std::shared_ptr<const void> event;
+			/* stamp.published is also when the event was queued. */
+			event_stamp stamp;
+		};
+
+		const std::size_t _m_component_id;
+		/* Exactly one of these is set. */
+		const callback_type _m_callback;
+		const batch_callback_type _m_batch_callback;
+		/* 0 unless this is a batch subscription. */
+		const std::size_t _m_max_batch;
+		dispatch_queue& _m_queue;
+		const priority_class _m_priority;
+		const overflow_policy _m_overflow;
+
+		std::mutex _m_ring_lock;
+		std::condition_variable _m_not_full;
+		std::vector<pending> _m_ring;
+		std::size_t _m_head = 0;
+		std::size_t _m_size = 0;
+		bool _m_closed = false;
+		std::size_t _m_unprocessed = 0;
+		std::size_t _m_dropped_oldest = 0;
+		std::size_t _m_dropped_newest = 0;
+		/* Batch subscriptions only: whether the worker's queue holds a token for this. */
+		bool _m_token_outstanding = false;
+
+		/* Batch subscriptions only: the batch being delivered. Only touched by the worker. */
+		std::vector<std::shared_ptr<const void>> _m_batch;
+		std::vector<event_stamp> _m_batch_stamps;
+
+		/* Executor mode only: tokens not yet redeemed. */
+		std::atomic<std::size_t> _m_posted {0};
+		/* Worker mode only: tokens in the worker's queue, or being redeemed. */
+		std::atomic<std::size_t> _m_queued {0};
+
+		__switchboard_callback_coalescer _m_cb_log;
+		std::atomic<std::size_t> _m_iteration_no {0};
+		std::array<std::atomic<std::size_t>, topic_stats::LATENCY_BUCKETS> _m_latency_us;
+	};
+
+	inline bool dispatch_queue::enqueue(subscription* sub, priority_class priority, std::size_t count) {
+		if (_m_executor) {
+			post(sub, count);
+			return true;
+		}
+		/* Before the worker can see them, so that it never redeems a token which is not counted. */
+		sub->hold(count);
+		return push(sub, priority, count);
+	}
+
+	inline void dispatch_queue::post(subscription* sub, std::size_t count) {
+		if (sub->post(count)) {
+			submit_drain(sub);
+		}
+	}
+
+	inline void dispatch_queue::submit_drain(subscription* sub) {
+		_m_executor->submit([this, sub]() {
+			if (sub->drain(DRAIN_BATCH)) {
+				submit_drain(sub);
+			}
+		});
+	}
+
+	/**
+	 * @brief A topic's recent events, shared by its buffered readers.
+	 *
+	 * A ring of (timestamp, event), oldest first. Created by the first buffered reader, and grown
+	 * (never shrunk) to satisfy later ones.
+	 */
+	class event_history {
+	public:
+		using time_point = std::chrono::system_clock::time_point;
+
+		explicit event_history(time_point (*time_of)(const void*))
+			: _m_time_of{time_of}
+		{ }
+
+		void reserve(std::size_t capacity, std::chrono::nanoseconds max_age) {
+			/* Proof of thread-safety: reads and modifies the ring after acquiring _m_history_lock. */
+			const std::lock_guard<std::mutex> lock{_m_history_lock};
+			if (capacity > _m_ring.size()) {
+				std::vector<entry> ring (capacity);
+				for (std::size_t i = 0; i < _m_size; ++i) {
+					ring[i] = std::move(at(i));
+				}
+				_m_ring = std::move(ring);
+				_m_head = 0;
+			}
+			_m_max_age = std::max(_m_max_age, max_age);
+		}
+
+		void push(const std::shared_ptr<const void>& event) {
+			/* Proof of thread-safety: reads and modifies the ring after acquiring _m_history_lock. */
+			const time_point time = _m_time_of(event.get());
+			const std::lock_guard<std::mutex> lock{_m_history_lock};
+			if (_m_ring.empty()) {
+				return;
+			}
+			if (_m_size == _m_ring.size()) {
+				pop_front();
+			}
+			_m_ring[(_m_head + _m_size) % _m_ring.size()] = entry{time, event};
+			_m_size++;
+			while (_m_size > 1 && time - at(0).time > _m_max_age) {
+				pop_front();
+			}
+		}
+
+		void get_range(time_point begin, time_point end, std::vector<std::shared_ptr<const void>>& out) const {
+			/* Proof of thread-safety: reads the ring after acquiring _m_history_lock. */
+			const std::lock_guard<std::mutex> lock{_m_history_lock};
+			const std::size_t last = upper_bound(end);
+			for (std::size_t i = lower_bound(begin); i < last; ++i) {
+				out.push_back(at(i).event);
+			}
+		}
+
+		void get_last(std::size_t n, std::vector<std::shared_ptr<const void>>& out) const {
+			/* Proof of thread-safety: reads the ring after acquiring _m_history_lock. */
+			const std::lock_guard<std::mutex> lock{_m_history_lock};
+			for (std::size_t i = _m_size - std::min(n, _m_size); i < _m_size; ++i) {
+				out.push_back(at(i).event);
+			}
+		}
+
+		std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>> get_bracket(time_point t) const {
+			/* Proof of thread-safety: reads the ring after acquiring _m_history_lock. */
+			const std::lock_guard<std::mutex> lock{_m_history_lock};
+			const std::size_t after = lower_bound(t);
+			const std::size_t past = upper_bound(t);
+			return {
+				past > 0 ? at(past - 1).event : nullptr,
+				after < _m_size ? at(after).event : nullptr,
+			};
+		}
+
+	private:
+		struct entry {
+			time_point time;
+			std::shared_ptr<const void> event;
+		};
+
+		/* The rest of these require _m_history_lock. Indices are logical: 0 is the oldest entry. */
+
+		entry& at(std::size_t i) {
+			return _m_ring[(_m_head + i) % _m_ring.size()];
+		}
+
+		const entry& at(std::size_t i) const {
+			return _m_ring[(_m_head + i) % _m_ring.size()];
+		}
+
+		void pop_front() {
+			at(0).event.reset();
+			_m_head = (_m_head + 1) % _m_ring.size();
+			_m_size--;
+		}
+
+		/* First index whose time is not before t, by binary search. */
+		std::size_t lower_bound(time_point t) const {
+			std::size_t lo = 0, hi = _m_size;
+			while (lo < hi) {
+				const std::size_t mid = lo + (hi - lo) / 2;
+				if (at(mid).time < t) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return lo;
+		}
+
+		/* First index whose time is after t, by binary search. */
+		std::size_t upper_bound(time_point t) const {
+			std::size_t lo = 0, hi = _m_size;
+			while (lo < hi) {
+				const std::size_t mid = lo + (hi - lo) / 2;
+				if (at(mid).time <= t) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return lo;
+		}
+
+		time_point (*const _m_time_of)(const void*);
+		mutable std::mutex _m_history_lock;
+		std::vector<entry> _m_ring;
+		std::size_t _m_head = 0;
+		std::size_t _m_size = 0;
+		std::chrono::nanoseconds _m_max_age {0};
+	};
 
 	class topic {
 	public:
 
+		class topic_buffered_reader : public buffered_reader<void> {
+		public:
+			virtual void get_range(time_point begin, time_point end, std::vector<std::shared_ptr<const void>>& out) const override {
+				/* Proof of thread-safety: _m_history is thread-safe. */
+				_m_history.get_range(begin, end, out);
+			}
+
+			virtual void get_last(std::size_t n, std::vector<std::shared_ptr<const void>>& out) const override {
+				/* Proof of thread-safety: _m_history is thread-safe. */
+				_m_history.get_last(n, out);
+			}
+
+			virtual std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>> get_bracket(time_point t) const override {
+				/* Proof of thread-safety: _m_history is thread-safe. */
+				return _m_history.get_bracket(t);
+			}
+
+			topic_buffered_reader(topic* topic, const event_history& history)
+				: _m_topic{topic}
+				, _m_history{history}
+			{
+				/* Proof of thread-safety: modifies _m_topic->_m_readers using atomics. */
+				_m_topic->_m_readers++;
+			}
+			virtual ~topic_buffered_reader() {
+				/* Proof of thread-safety: modifies _m_topic->_m_readers using atomics. */
+				_m_topic->_m_readers--;
+			}
+
+		private:
+			topic *const _m_topic;
+			const event_history& _m_history;
+		};
+
 		class topic_reader_latest : public reader_latest<void> {
 		public:
-			virtual const void* get_latest_ro() const override {
+			virtual std::shared_ptr<const void> get_latest_ro() const override {
 				/* Proof of thread-safety:
 				   - Reads _m_topic, which is const.
-				   - Reads _m_topic->_m_latest using atomics.
+				   - Reads _m_topic->_m_latest using atomics. The stamped_event it points to is immutable.
+				   - Modifies trace_context, which is thread-local.
 				*/
-				return _m_topic->_m_latest.load();
+				const std::shared_ptr<const stamped_event> latest = std::atomic_load(&_m_topic->_m_latest);
+				if (!latest) {
+					return nullptr;
+				}
+				trace_context::adopt(latest->stamp);
+				return latest->event;
 			}
 
-			virtual void* get_latest() const override {
-				/* Proof of thread-safety is TBD, as the implementation is also. */
-
-				/* TODO: (feature) support this method. The immediate problem is that the type has
-				   been erased at this point, so I don't know how to copy a void*. */
-				throw std::runtime_error{"this doesn't work yet"};
-				/* TODO: (optimization) avoid this copy if we are the only subscriber. The reader
-				   can read and modify the event in place. */
+			virtual std::shared_ptr<void> get_latest() const override {
+				/* Proof of thread-safety:
+				   - Reads _m_topic, which is const.
+				   - Reads _m_topic->_m_latest and _m_topic->_m_readers using atomics, and _m_topic->_m_active through an active_pin.
+				   - Hands over the event only after taking it out of _m_latest (with a compare-and-swap), and
+				     only if my copy of the stamped_event and its event are then the only references. A reader
+				     which registers concurrently can only reach the event through _m_latest, so once it is
+				     taken out and unshared, nobody else can start observing it.
+				   - If it turns out to be shared, puts it back, unless put() has stored a newer event since.
+				   - Otherwise, copies the event through _m_topic->_m_type, which is const.
+				   - Modifies trace_context, which is thread-local.
+				*/
+				const std::shared_ptr<const stamped_event> latest = std::atomic_load(&_m_topic->_m_latest);
+				if (!latest) {
+					return nullptr;
+				}
+				trace_context::adopt(latest->stamp);
+				/* Only worth trying when nobody else seems to be reading. */
+				if (_m_topic->_m_readers.load() == 1
+					&& topic::active_pin{*_m_topic}->empty()
+					&& latest->event.use_count() == 1) {
+					std::shared_ptr<const stamped_event> expected = latest;
+					if (std::atomic_compare_exchange_strong(&_m_topic->_m_latest, &expected, std::shared_ptr<const stamped_event>{})) {
+						expected.reset();
+						if (latest.use_count() == 1 && latest->event.use_count() == 1) {
+							return std::const_pointer_cast<void>(latest->event);
+						}
+						std::shared_ptr<const stamped_event> taken;
+						std::atomic_compare_exchange_strong(&_m_topic->_m_latest, &taken, latest);
+					}
+				}
+				std::shared_ptr<void> copy = _m_topic->_m_type.copy(latest->event.get(), _m_topic->_m_pool);
+				if (!copy) {
+					throw std::runtime_error{"get_latest() needs to copy the event, but its type is not copyable"};
+				}
+				return copy;
 			}
-			topic_reader_latest(const topic* topic) : _m_topic{topic} {
-				/* No thread-safety required in constructor. This is only called by one thread. */
+			topic_reader_latest(topic* topic) : _m_topic{topic} {
+				/* Proof of thread-safety: modifies _m_topic->_m_readers using atomics. */
+				_m_topic->_m_readers++;
 			}
 			virtual ~topic_reader_latest() {
-				/* No thread-safety required in destructor. This is only called by the owning thread. */
+				/* Proof of thread-safety: modifies _m_topic->_m_readers using atomics. */
+				_m_topic->_m_readers--;
 			}
 
 		private:
-			const topic *const _m_topic;
+			topic *const _m_topic;
+		};
+
+		class topic_reader : public reader<void> {
+		public:
+			virtual std::shared_ptr<const void> wait_next(std::chrono::nanoseconds timeout) override {
+				/* Proof of thread-safety:
+				   - Reads and modifies _m_seq and _m_last, which only the owning thread uses.
+				   - Calls _m_topic->wait_for_seq (see its proof of thread-safety).
+				   - Reads _m_topic->_m_seq, then _m_topic->_m_latest, using atomics. put() stores them in
+				     the opposite order, so the event I load is at least as new as the sequence number.
+				     If it is the event I already returned, the new sequence number was for that event, so wait again.
+				   - Modifies trace_context, which is thread-local.
+				*/
+				const auto deadline = std::chrono::steady_clock::now() + timeout;
+				while (_m_topic->wait_for_seq(_m_seq + 1, deadline)) {
+					_m_seq = _m_topic->_m_seq.load();
+					const std::shared_ptr<const stamped_event> latest = std::atomic_load(&_m_topic->_m_latest);
+					/* Null if a sole reader_latest took it (see get_latest). */
+					if (latest && latest->event != _m_last) {
+						_m_last = latest->event;
+						trace_context::adopt(latest->stamp);
+						return _m_last;
+					}
+				}
+				return nullptr;
+			}
+
+			virtual std::shared_ptr<const void> wait_until(std::uint64_t seq, std::chrono::nanoseconds timeout) override {
+				/* Proof of thread-safety: same as wait_next. */
+				if (!_m_topic->wait_for_seq(seq, std::chrono::steady_clock::now() + timeout)) {
+					return nullptr;
+				}
+				_m_seq = _m_topic->_m_seq.load();
+				const std::shared_ptr<const stamped_event> latest = std::atomic_load(&_m_topic->_m_latest);
+				if (!latest) {
+					return nullptr;
+				}
+				trace_context::adopt(latest->stamp);
+				_m_last = latest->event;
+				return _m_last;
+			}
+
+			virtual std::uint64_t seq() const override {
+				return _m_seq;
+			}
+
+			virtual void notify_next(std::function<void()> callback) override {
+				/* Proof of thread-safety: reads _m_seq, which only the owning thread uses, and calls _m_topic->notify_at_seq (see its proof of thread-safety). */
+				_m_topic->notify_at_seq(_m_seq + 1, std::move(callback));
+			}
+
+			topic_reader(topic* topic) : _m_topic{topic} {
+				/* Proof of thread-safety: modifies _m_topic->_m_readers using atomics. */
+				_m_topic->_m_readers++;
+			}
+			virtual ~topic_reader() {
+				/* Proof of thread-safety: modifies _m_topic->_m_readers using atomics. */
+				_m_topic->_m_readers--;
+			}
+
+		private:
+			topic *const _m_topic;
+			std::uint64_t _m_seq = 0;
+			/* Held so that a recycled block cannot be mistaken for the event I already returned. */
+			std::shared_ptr<const void> _m_last;
 		};
 
 		class topic_writer : public writer<void> {
 		public:
-			virtual void* allocate() override {
-				/* TODO: (feature:allocate) support this method. The immediate problem is that the
-				   type has been erased at this point, so I don't know how to copy a void*. */
-				throw std::runtime_error{"this doesn't work yet"};
-				/* Note on memory safety: allocated pointers always get moved into put(). Then they
-				   are always freed when put() is called again or when the destructor is called. */
-				/* TODO: (optimization:free-list) pop from free list if non-empty. */
+			virtual std::shared_ptr<event_pool> get_pool() const override {
+				/* Proof of thread-safety: _m_topic->_m_pool is const. The pool itself is thread-safe. */
+				return _m_topic->_m_pool;
+			}
 
+			virtual void put(std::shared_ptr<const void>&& contents) override {
+				put_bulk(&contents, 1);
 			}
 
-			virtual void put(const void* contents) override {
+			virtual void put_bulk(std::shared_ptr<const void>* events, std::size_t count) override {
 				/*
 				  Proof of thread-safety:
 				   - Reads _m_topic, which is const.
-				  - Modifies _m_topic->_m_latest using atomics
-				  - Modifies _m_topic->_m_queue using concurrent primitives
+				  - Modifies _m_topic->_m_latest with std::atomic_store. The stamped_event is built before it is stored, and never modified after.
+				      - Note that this is not lock-free: libstdc++ implements std::atomic_load/std::atomic_store on a shared_ptr with a small
+				        pool of mutexes, hashed by address and shared by every topic. Each is held only while the pointer is swapped.
+				  - Reads trace_context, which is thread-local.
+				  - Reads a snapshot of _m_topic->_m_active through an active_pin, which takes no lock. The snapshot is immutable,
+				    and is not freed while pinned (see topic::reclaim), so iterating it needs no lock either.
+				      - The pin lasts until every token is queued, so a subscription is not freed while this may still queue one for it.
+				      - A subscription removed after the snapshot was taken may still be pushed to; it is closed, so push just counts the event as unprocessed.
+				  - Holds no lock while pushing, since push may block (see subscription::push).
+				  - Modifies each subscription's ring under its own lock (once per batch), and the worker's queue using concurrent primitives
+				  - Hands the worker the subscription itself, so nothing here copies the topic name, hashes, or touches _m_registry_lock.
+				  - Reads _m_topic->_m_log, which is set before any writer exists (see record_to), and appends to it under its own lock.
+				  - Reads _m_topic->_m_history using atomics, and pushes to it under its own lock (see event_history).
+				  - Modifies _m_topic->_m_seq using atomics, and only acquires _m_seq_lock if a reader is waiting (see wait_for_seq).
+				  - Calls _m_topic->update_rate, which never waits for a lock (see its proof of thread-safety).
+				  - The old event is released through its shared_ptr, whose reference-count is atomic.
+				    If this was the last reference, the event is destroyed and its block returns to _m_topic->_m_pool.
 
 				  One caveat:
 				  While there is no data-race here, there is a synchronization race.
 				  In the case where there are multiple writers to a topic,
-				  A reader observing _m_latest could see events in a different order than those observing _m_queue!
+				  A reader observing _m_latest could see events in a different order than those observing the queues!
 				  However, I contend this is not a problem, because I only guarantee that _m_topic->_m_latest has 'sufficiently fresh data',
 				  so if 2 events come in at the same time, I don't care which I publish to _m_latest.
 				  Also, there is not currently any case where two threads write to the same topic in ILLIXR.
-				  I don't want to acquire a lock here because it would be contended.
+				  I don't want to hold a lock while updating _m_latest because it would be contended.
 				*/
-				assert(contents);
-				const void* old __attribute__((unused)) =
-					_m_topic->_m_latest.exchange(contents);
-
-				// delete old;
-				/* TODO: (feature:allocate) Free old.*/
-				/* TODO: (optimization:free-list) return to free-list. */
-				[[maybe_unused]] int ret = _m_topic->_m_queue.enqueue(std::make_pair(_m_topic->_m_name, contents));
-				// Unused if the assert is not on.
-				assert(ret);
+				assert(count > 0);
+				for (std::size_t i = 0; i < count; ++i) {
+					assert(events[i]);
+					if (_m_topic->_m_log) {
+						_m_topic->_m_log->add_event(_m_topic->_m_log_id, _m_topic->_m_type, events[i].get());
+					}
+				}
+				const event_stamp stamp = _m_topic->stamp();
+				{
+					const topic::active_pin active{*_m_topic};
+					for (subscription* sub : *active) {
+						if (const std::size_t tokens = sub->push(events, count, stamp)) {
+							[[maybe_unused]] bool ret = sub->get_queue().enqueue(sub, sub->priority(), tokens);
+							// Unused if the assert is not on.
+							assert(ret);
+						}
+					}
+				}
+				if (event_history* history = _m_topic->_m_history.load()) {
+					for (std::size_t i = 0; i < count; ++i) {
+						history->push(events[i]);
+					}
+				}
+				/* Only the newest becomes the latest. The others are released here, unless someone else holds them. */
+				std::atomic_store(&_m_topic->_m_latest, std::allocate_shared<const stamped_event>(
+					event_pool_allocator<const stamped_event>{_m_topic->_m_stamp_pool}, stamped_event{std::move(events[count - 1]), stamp}
+				));
+				for (std::size_t i = 0; i + 1 < count; ++i) {
+					events[i].reset();
+				}
+
+				/* Only touch the lock when someone is waiting (see wait_for_seq). */
+				const std::uint64_t seq = _m_topic->_m_seq += count;
+				_m_topic->update_rate(stamp.published, seq);
+				if (_m_topic->_m_waiters.load() > 0) {
+					_m_topic->wake_waiters();
+				}
 			}
 
 			topic_writer(topic* topic) : _m_topic{topic} {
-				/* No need for thread-safety, constructor is only called from one thread. */
+				/* Proof of thread-safety: modifies _m_topic->_m_writers using atomics. */
+				_m_topic->_m_writers++;
 			}
 			virtual ~topic_writer() {
-				/* No need for thread-safety, destructor is only called from owning thread. */
+				/* Proof of thread-safety: modifies _m_topic->_m_writers using atomics. */
+				_m_topic->_m_writers--;
 			}
 
 		private:
-			/* TODO: (optimization:free-list) maintain a free-list. allocate should pop and return
-			   an object from the list. The destructor should put it back on the list. This needs to
-			   be done in the destructor, not in `put`, because even though the reader_latest are
-			   not reading the object, it could still be scheduled for synchronous processing. */
-			/* TODO: (optimization) pre-allocate in a static array. */
 			topic * const _m_topic;
 		};
 
@@ -143,7 +1139,107 @@ namespace ILLIXR {
 			return std::make_unique<topic_writer>(this);
 		}
 
-		std::unique_ptr<topic_reader_latest> get_reader_latest() const {
+		std::unique_ptr<topic_reader> get_reader() {
+			/*
+			 * Proof of thread-safety:
+			 * See topic_reader proof of thread-safety.
+			 */
+			return std::make_unique<topic_reader>(this);
+		}
+
+		/**
+		 * @brief Waits until at least @p seq events have been published, or @p deadline passes.
+		 *
+		 * @return whether @p seq was reached.
+		 */
+		bool wait_for_seq(std::uint64_t seq, std::chrono::steady_clock::time_point deadline) {
+			/*
+			 * Proof of thread-safety:
+			 * - Reads _m_seq using atomics, and waits on _m_seq_cv under _m_seq_lock.
+			 * - No lost wakeups: I increment _m_waiters before checking _m_seq under the lock, and put()
+			 *   increments _m_seq before checking _m_waiters (both sequentially consistent). So either
+			 *   I see the new _m_seq, or put() sees me waiting, acquires the lock (so I am either
+			 *   before my check or already waiting), and notifies.
+			 */
+			if (_m_seq.load() >= seq) {
+				return true;
+			}
+			_m_waiters++;
+			bool reached;
+			{
+				std::unique_lock<std::mutex> lock{_m_seq_lock};
+				reached = _m_seq_cv.wait_until(lock, deadline, [&] { return _m_seq.load() >= seq; });
+			}
+			_m_waiters--;
+			return reached;
+		}
+
+		/**
+		 * @brief Calls @p callback once _m_seq reaches @p seq: right away, or from the put() which gets it there.
+		 *
+		 * Proof of thread-safety: same as wait_for_seq, with the watcher counted in _m_waiters
+		 * until wake_waiters takes it (under _m_seq_lock).
+		 */
+		void notify_at_seq(std::uint64_t seq, std::function<void()> callback) {
+			_m_waiters++;
+			{
+				const std::lock_guard<std::mutex> lock{_m_seq_lock};
+				if (_m_seq.load() < seq) {
+					_m_seq_watchers.push_back(seq_watcher{seq, std::move(callback)});
+					return;
+				}
+			}
+			_m_waiters--;
+			callback();
+		}
+
+		/**
+		 * @brief Wakes the readers waiting in wait_for_seq, and calls the watchers whose seq has been reached.
+		 */
+		void wake_waiters() {
+			/*
+			 * Proof of thread-safety:
+			 * - Reads and modifies _m_seq_watchers after acquiring _m_seq_lock.
+			 * - Calls the watchers after releasing it, so they may call notify_at_seq again.
+			 */
+			std::vector<std::function<void()>> due;
+			{
+				const std::lock_guard<std::mutex> lock{_m_seq_lock};
+				if (!_m_seq_watchers.empty()) {
+					const std::uint64_t seq = _m_seq.load();
+					const auto reached = std::partition(_m_seq_watchers.begin(), _m_seq_watchers.end(), [seq](const seq_watcher& watcher) {
+						return watcher.seq > seq;
+					});
+					for (auto it = reached; it != _m_seq_watchers.end(); ++it) {
+						due.push_back(std::move(it->callback));
+					}
+					_m_seq_watchers.erase(reached, _m_seq_watchers.end());
+				}
+			}
+			_m_waiters -= due.size();
+			_m_seq_cv.notify_all();
+			for (std::function<void()>& callback : due) {
+				callback();
+			}
+		}
+
+		std::unique_ptr<topic_buffered_reader> get_buffered_reader(std::size_t capacity, std::chrono::nanoseconds max_age, event_history::time_point (*time_of)(const void*)) {
+			/*
+			 * Proof of thread-safety:
+			 * - Creates _m_history_owner after acquiring _m_callbacks_lock, so only once.
+			 * - Publishes it to put() through the atomic _m_history. It is never replaced or freed
+			 *   before the topic, so put() can use the raw pointer.
+			 */
+			const std::lock_guard<std::mutex> lock{_m_callbacks_lock};
+			if (!_m_history_owner) {
+				_m_history_owner = std::make_unique<event_history>(time_of);
+				_m_history.store(_m_history_owner.get());
+			}
+			_m_history_owner->reserve(capacity, max_age);
+			return std::make_unique<topic_buffered_reader>(this, *_m_history_owner);
+		}
+
+		std::unique_ptr<topic_reader_latest> get_reader_latest() {
 			/*
 			 * Proof of thread-safety:
 			 * See topic_reader_latest proof of thread-safety.
@@ -151,28 +1247,217 @@ namespace ILLIXR {
 			return std::make_unique<topic_reader_latest>(this);
 		}
 
-		void schedule(std::size_t component_id, std::function<void(const void*)> callback) {
+		/**
+		 * @brief The snapshot in _m_active, which reclaim will not free while this is alive.
+		 *
+		 * Keep it short-lived: while any pin is alive, reclaim frees nothing.
+		 */
+		class active_pin {
+		public:
+			explicit active_pin(topic& topic_)
+				: _m_topic{topic_}
+			{
+				/* Before loading, so that reclaim either sees the pin, or has already published what this loads. */
+				_m_topic._m_pinned++;
+				_m_active = _m_topic._m_active.load();
+			}
+
+			~active_pin() {
+				_m_topic._m_pinned--;
+			}
+
+			active_pin(const active_pin&) = delete;
+			active_pin& operator=(const active_pin&) = delete;
+
+			const std::vector<subscription*>& operator*() const {
+				return *_m_active;
+			}
+
+			const std::vector<subscription*>* operator->() const {
+				return _m_active;
+			}
+
+		private:
+			topic& _m_topic;
+			const std::vector<subscription*>* _m_active;
+		};
+
+		/**
+		 * @brief Adds a subscription, built from @p args (see subscription's constructors).
+		 */
+		template <typename... Args>
+		void schedule(Args&&... args) {
+			/*
+			 * Proof of thread-safety:
+			 * - Modifies _m_subscriptions and replaces _m_active after acquiring _m_callbacks_lock, so
+			 *   concurrent schedule/unschedule calls do not lose each other's updates.
+			 * - Publishes the new list with an atomic store (see publish_active). Writers still iterating
+			 *   the old snapshot are unaffected, since it is only freed once none is (see reclaim).
+			 */
+			const std::lock_guard<std::mutex> lock{_m_callbacks_lock};
+			_m_subscriptions.push_back(std::make_unique<subscription>(_m_record_logger, std::forward<Args>(args)...));
+			subscription* sub = _m_subscriptions.back().get();
+			if (_m_closed) {
+				sub->close();
+				return;
+			}
+			auto active = std::make_unique<std::vector<subscription*>>(*_m_current);
+			active->push_back(sub);
+			publish_active(std::move(active));
+		}
+
+		void unschedule(std::size_t component_id) {
+			/*
+			 * Proof of thread-safety: same as schedule.
+			 * The removed subscriptions are closed, and freed later, once nothing can reach them (see reclaim).
+			 */
 			const std::lock_guard<std::mutex> lock{_m_callbacks_lock};
-			_m_callbacks.push_back({component_id, callback});
+			auto active = std::make_unique<std::vector<subscription*>>();
+			for (subscription* sub : *_m_current) {
+				if (sub->component_id() == component_id) {
+					sub->close();
+				} else {
+					active->push_back(sub);
+				}
+			}
+			publish_active(std::move(active));
+		}
+
+		/**
+		 * @brief Makes @p active the list which put() delivers to. Call under _m_callbacks_lock.
+		 */
+		void publish_active(std::unique_ptr<const std::vector<subscription*>> active) {
+			_m_active.store(active.get());
+			if (_m_current) {
+				_m_retired.push_back(std::move(_m_current));
+			}
+			_m_current = std::move(active);
+			reclaim();
+		}
+
+		/**
+		 * @brief Frees the replaced snapshots, and the closed subscriptions, which nothing can reach any more. Call under _m_callbacks_lock.
+		 *
+		 * Proof of thread-safety:
+		 * - Every load of _m_active happens inside an active_pin, and _m_pinned and _m_active are
+		 *   sequentially consistent. So if _m_pinned reads 0 here, every pin taken before then has
+		 *   been dropped, and every later one loads _m_current (or a newer snapshot). So no thread
+		 *   holds a retired snapshot.
+		 * - A subscription which is closed and not in _m_current is then unreachable by writers, and
+		 *   put() queues its tokens before dropping its pin. So if it is also idle, no token for it is
+		 *   queued or being redeemed, and none will be (a batch subscription only re-queues itself while
+		 *   redeeming a token). Closed subscriptions still in _m_current (see close) are kept.
+		 * - If a writer holds a pin, this frees nothing, and a later schedule, unschedule, or stats tries again.
+		 * - Folds the freed subscriptions' counters into _m_reclaimed, so stats() does not go backwards.
+		 */
+		void reclaim() {
+			if (_m_pinned.load() != 0) {
+				return;
+			}
+			_m_retired.clear();
+			const auto freed = std::stable_partition(_m_subscriptions.begin(), _m_subscriptions.end(), [this](const std::unique_ptr<subscription>& sub) {
+				return !sub->closed()
+					|| !sub->idle()
+					|| std::find(_m_current->begin(), _m_current->end(), sub.get()) != _m_current->end();
+			});
+			for (auto it = freed; it != _m_subscriptions.end(); ++it) {
+				(*it)->add_stats(_m_reclaimed);
+			}
+			_m_subscriptions.erase(freed, _m_subscriptions.end());
+		}
+
+		void close() {
+			/*
+			 * Proof of thread-safety:
+			 * - Reads _m_subscriptions after acquiring its lock.
+			 * - Calls subscription::close (see its proof of thread-safety).
+			 */
+			const std::lock_guard<std::mutex> lock{_m_callbacks_lock};
+			_m_closed = true;
+			for (const auto& sub : _m_subscriptions) {
+				sub->close();
+			}
 		}
 
 		std::size_t ty() {
-			/* Proof of thread-safety: ty is immutable*/
-			return _m_ty;
+			/* Proof of thread-safety: _m_type is immutable*/
+			return _m_type.hash;
+		}
+
+		const event_type& type() const {
+			/* Proof of thread-safety: _m_type is immutable*/
+			return _m_type;
+		}
+
+		const std::string& name() const {
+			/* Proof of thread-safety: _m_name is immutable*/
+			return _m_name;
 		}
 
-		topic(std::shared_ptr<record_logger> record_logger_, std::size_t ty, const std::string name, queue<std::pair<std::string, const void*>>& queue)
+		/**
+		 * @brief Appends every event put on this topic to @p log, which must outlive the topic.
+		 *
+		 * Proof of thread-safety: only called by switchboard_impl::get_topic, under _m_registry_lock,
+		 * right after creating the topic. No handle exists yet, and handles are only handed out
+		 * after acquiring the same lock, so every writer sees _m_log.
+		 */
+		void record_to(event_log::writer& log) {
+			_m_log_id = log.add_topic(_m_name, _m_type.hash, _m_type.layout);
+			_m_log = &log;
+		}
+
+		/**
+		 * @brief Logs a switchboard_trace record for every event put on this topic on behalf of another.
+		 *
+		 * Proof of thread-safety: same as record_to.
+		 */
+		void trace() {
+			_m_trace = true;
+		}
+
+		/**
+		 * @brief Stamps an event being put on this topic now.
+		 *
+		 * Proof of thread-safety:
+		 * - Reads and modifies trace_context, which is thread-local.
+		 * - Reads _m_trace_name, _m_trace, and _m_record_logger, which are not modified after the first handle is handed out.
+		 */
+		event_stamp stamp() const {
+			const event_stamp parent = trace_context::current();
+			trace_context::reset();
+			event_stamp stamp;
+			stamp.published = std::chrono::steady_clock::now();
+			stamp.topic_name = _m_trace_name;
+			if (parent.trace_id == 0) {
+				/* Nothing caused this event (as far as switchboard can tell), so it starts a trace. */
+				stamp.trace_id = trace_context::new_trace_id();
+				stamp.origin = stamp.published;
+				return stamp;
+			}
+			stamp.trace_id = parent.trace_id;
+			stamp.origin = parent.origin;
+			if (_m_trace) {
+				_m_record_logger->log(record{__switchboard_trace_header, {
+					{_m_name},
+					{static_cast<std::size_t>(stamp.trace_id)},
+					{*parent.topic_name},
+					{std::chrono::duration_cast<std::chrono::nanoseconds>(stamp.published - parent.published)},
+					{std::chrono::duration_cast<std::chrono::nanoseconds>(stamp.published - stamp.origin)},
+				}});
+			}
+			return stamp;
+		}
+
+		topic(std::shared_ptr<record_logger> record_logger_, const event_type& type, const std::string name)
 			: _m_record_logger{record_logger_}
-			, _m_cb_log {_m_record_logger}
-			, _m_ty{ty}
+			, _m_type{type}
+			, _m_pool{std::make_shared<slab_pool>()}
+			, _m_stamp_pool{std::make_shared<slab_pool>()}
 			, _m_name{name}
-			, _m_queue{queue}
+			, _m_trace_name{trace_context::intern(name)}
 		{
 			/* No need for thread-safety, constructor is only called from one thread. */
-		}
-
-		void mark_unprocessed(const void*) {
-			_m_unprocessed++;
+			publish_active(std::make_unique<const std::vector<subscription*>>());
 		}
 
 		~topic() {
@@ -180,71 +1465,276 @@ namespace ILLIXR {
 			 * No need for thread-safety:
 			 * Destrutctor should only be called from one thread (the thread owning switchboard)
 			 */
-			const void* latest = _m_latest.exchange(nullptr);
-			if (latest) {
-				/* TODO: (feature:allocate) Free old.*/
-			}
-			/* TODO: (optimization:free-list) free the elements of free-list. */
+			/* _m_latest is released by its destructor. _m_pool is freed once the last event allocated
+			   from it is released. */
 
+			const topic_stats final_stats = stats();
 			_m_record_logger->log(record{__switchboard_topic_stop_header, {
 				{_m_name},
-				{_m_iteration_no},
-				{_m_unprocessed},
+				{final_stats.processed},
+				{final_stats.unprocessed},
+				{final_stats.dropped_oldest},
+				{final_stats.dropped_newest},
 			}});
 		}
 
-		void invoke_callbacks(const void* event) {
+		topic_stats stats() {
 			/*
 			 * Proof of thread-safety:
-			 * - All reads _m_callbacks occur after acquiring its lock.
-			 * - Callback cannot call `check_queues`, because it is private to this class. Therefore, it cannot cause a deadlock
-			 *
-			 * Note: this function can only be called by the switchboard_impl::_m_threads, because the topic class is not exposed.
-			 * TODO: Should be a private inner-class to guarantee this.
-			 *
-			 * One caveat:
-			 * - callback should not attempt to create a new subscription, publish, or schedule (that would try to acquire _m_registry_lock)
+			 * - Reads _m_name and _m_type, which are const.
+			 * - Reads the handle counts and _m_seq using atomics.
+			 * - Reads _m_current, _m_reclaimed, and _m_subscriptions after acquiring _m_callbacks_lock, and calls
+			 *   subscription::add_stats (see its proof of thread-safety). Also calls reclaim, so that a topic
+			 *   which is no longer (un)scheduled still frees what it can.
+			 * - Reads the publish-rate window after acquiring _m_rate_lock. It only reads, so callers
+			 *   (e.g. debugview and a test) do not disturb each other's rates.
+			 * put() only ever try-locks _m_rate_lock (see update_rate), so publishers are not slowed down.
 			 */
+			topic_stats stats {};
+			stats.name = _m_name;
+			stats.type_hash = _m_type.hash;
+			stats.writers = _m_writers.load();
+			stats.readers = _m_readers.load();
+			stats.published = _m_seq.load();
+			{
+				const std::lock_guard<std::mutex> lock{_m_callbacks_lock};
+				reclaim();
+				stats.callbacks = _m_current->size();
+				stats.processed = _m_reclaimed.processed;
+				stats.unprocessed = _m_reclaimed.unprocessed;
+				stats.dropped_oldest = _m_reclaimed.dropped_oldest;
+				stats.dropped_newest = _m_reclaimed.dropped_newest;
+				stats.callback_latency_us = _m_reclaimed.callback_latency_us;
+				for (const auto& sub : _m_subscriptions) {
+					sub->add_stats(stats);
+				}
+			}
+			{
+				const std::lock_guard<std::mutex> lock{_m_rate_lock};
+				const std::chrono::duration<double> window = std::chrono::steady_clock::now() - _m_rate_base_start;
+				stats.publish_rate = window.count() > 0 ? (stats.published - _m_rate_base_seq) / window.count() : 0;
+			}
+			return stats;
+		}
+
+		/**
+		 * @brief How many subscriptions (including closed ones not yet reclaimed), and replaced snapshots, this still owns.
+		 */
+		std::pair<std::size_t, std::size_t> retained() {
+			/* Proof of thread-safety: reads _m_subscriptions and _m_retired after acquiring _m_callbacks_lock. */
 			const std::lock_guard<std::mutex> lock{_m_callbacks_lock};
-			for (const auto& pair : _m_callbacks) {
-				auto cb_start_cpu_time  = thread_cpu_time();
-				auto cb_start_wall_time = std::chrono::high_resolution_clock::now();
-				pair.second(event);
-				_m_cb_log.log(record{__switchboard_callback_header, {
-					{pair.first},
-					{_m_iteration_no},
-					{cb_start_cpu_time},
-					{thread_cpu_time()},
-					{cb_start_wall_time},
-					{std::chrono::high_resolution_clock::now()},
-				}});
+			return {_m_subscriptions.size(), _m_retired.size()};
+		}
+
+		/**
+		 * @brief Called by put() after publishing, to roll the publish-rate window every RATE_WINDOW.
+		 *
+		 * stats() reports the rate since the start of the previous window, so over the last one to
+		 * two windows. A topic which stops publishing stops rolling, so its rate decays towards 0.
+		 */
+		void update_rate(std::chrono::steady_clock::time_point now, std::uint64_t seq) {
+			/*
+			 * Proof of thread-safety:
+			 * - Reads _m_rate_recent_start using atomics, so the common case takes no lock.
+			 * - Modifies the window only after acquiring _m_rate_lock. Only try-locks it, so a
+			 *   publisher never waits; if another writer (or stats()) holds it, the next put() rolls instead.
+			 */
+			if (now - _m_rate_recent_start.load() < RATE_WINDOW) {
+				return;
 			}
-			_m_iteration_no++;
+			const std::unique_lock<std::mutex> lock{_m_rate_lock, std::try_to_lock};
+			if (!lock.owns_lock() || now - _m_rate_recent_start.load() < RATE_WINDOW) {
+				return;
+			}
+			_m_rate_base_start = _m_rate_recent_start.load();
+			_m_rate_base_seq = _m_rate_recent_seq;
+			_m_rate_recent_start.store(now);
+			_m_rate_recent_seq = seq;
 		}
 
 	private:
 
 		const std::shared_ptr<record_logger> _m_record_logger;
-		record_coalescer _m_cb_log;
-		const std::size_t _m_ty;
-		std::atomic<const void*> _m_latest {nullptr};
-		std::vector<std::pair<std::size_t, std::function<void(const void*)>>> _m_callbacks;
+		/* Supplied by whoever first named this topic. Every later user must agree on its hash. */
+		const event_type& _m_type;
+		const std::shared_ptr<slab_pool> _m_pool;
+		/* Null unless recording (see record_to). */
+		event_log::writer* _m_log = nullptr;
+		std::uint32_t _m_log_id = 0;
+		/* See trace(). */
+		bool _m_trace = false;
+		/* Holds the stamped_events in _m_latest, so that put() does not touch the heap. */
+		const std::shared_ptr<slab_pool> _m_stamp_pool;
+		/* Accessed only through std::atomic_load and std::atomic_store. */
+		std::shared_ptr<const stamped_event> _m_latest;
+		/* Null until the first buffered reader. See get_buffered_reader. */
+		std::unique_ptr<event_history> _m_history_owner;
+		std::atomic<event_history*> _m_history {nullptr};
+		/* Number of live writer handles. */
+		std::atomic<std::size_t> _m_writers {0};
+		/* Number of live reader_latest, reader, and buffered_reader handles. */
+		std::atomic<std::size_t> _m_readers {0};
+		/* The publish-rate window (see update_rate). stats() measures from the base; put() moves the
+		   base up to the recent one every RATE_WINDOW. Modified only under _m_rate_lock. */
+		static constexpr std::chrono::seconds RATE_WINDOW {1};
+		std::mutex _m_rate_lock;
+		std::chrono::steady_clock::time_point _m_rate_base_start {std::chrono::steady_clock::now()};
+		std::uint64_t _m_rate_base_seq = 0;
+		/* Also read without the lock, by put(). */
+		std::atomic<std::chrono::steady_clock::time_point> _m_rate_recent_start {_m_rate_base_start};
+		std::uint64_t _m_rate_recent_seq = 0;
+		/* Number of events published so far. Incremented after _m_latest is stored. */
+		std::atomic<std::uint64_t> _m_seq {0};
+		/* Number of threads in wait_for_seq. */
+		std::atomic<std::size_t> _m_waiters {0};
+		std::mutex _m_seq_lock;
+		std::condition_variable _m_seq_cv;
+		struct seq_watcher {
+			std::uint64_t seq;
+			std::function<void()> callback;
+		};
+		/* Callbacks from notify_at_seq. Only accessed under _m_seq_lock. */
+		std::vector<seq_watcher> _m_seq_watchers;
+		/* Immutable snapshot of the subscriptions which put() delivers to. A plain atomic pointer, so
+		   that loading it takes no lock; replaced (copy-on-write) under _m_callbacks_lock. Only load it
+		   through an active_pin. */
+		std::atomic<const std::vector<subscription*>*> _m_active {nullptr};
+		/* Number of active_pins alive. */
+		std::atomic<std::size_t> _m_pinned {0};
+		/* Owns the snapshot in _m_active. Guarded by _m_callbacks_lock. */
+		std::unique_ptr<const std::vector<subscription*>> _m_current;
+		/* Replaced snapshots, which a writer may still be iterating. Freed by reclaim. Guarded by _m_callbacks_lock. */
+		std::vector<std::unique_ptr<const std::vector<subscription*>>> _m_retired;
+		/* Owns every subscription not yet reclaimed, including unscheduled ones. Guarded by _m_callbacks_lock. */
+		std::vector<std::unique_ptr<subscription>> _m_subscriptions;
+		/* Counters of the subscriptions freed by reclaim. Guarded by _m_callbacks_lock. */
+		topic_stats _m_reclaimed {};
+		bool _m_closed = false;
 		std::mutex _m_callbacks_lock;
 		const std::string _m_name;
-		std::size_t _m_iteration_no = 0;
-		std::size_t _m_unprocessed = 0;
-		queue<std::pair<std::string, const void*>>& _m_queue;
+		/* The same, interned for event stamps (see trace_context::intern). */
+		const std::string* const _m_trace_name;
 		/* - const because nobody should write to the _m_latest in
 		   place. This is not thread-safe.
 		   - atomic because it will be accessed from different threads. */
-		/* TODO: (optimization) use unique_ptr when there is only one
-		   subscriber. */
 		/* TODO: (optimization) use relaxed memory_order? */
 
 	};
 
 	const size_t MAX_EVENTS = 127;
-	const size_t MAX_THREADS = 1;
+	const size_t DEFAULT_THREADS = 4;
+
+	/**
+	 * @brief Number of switchboard workers, from `ILLIXR_SWITCHBOARD_THREADS`.
+	 *
+	 * Defaults to `DEFAULT_THREADS`, but never more than the number of cores.
+	 */
+	static std::size_t get_switchboard_threads() {
+		const char* ILLIXR_SWITCHBOARD_THREADS = getenv("ILLIXR_SWITCHBOARD_THREADS");
+		if (ILLIXR_SWITCHBOARD_THREADS) {
+			return std::max(std::size_t{1}, static_cast<std::size_t>(std::stoul(std::string{ILLIXR_SWITCHBOARD_THREADS})));
+		}
+		return std::max(std::size_t{1}, std::min(DEFAULT_THREADS, static_cast<std::size_t>(std::thread::hardware_concurrency())));
+	}
+
+	/**
+	 * @brief Configuration of the workers dedicated to priority_class::realtime callbacks.
+	 *
+	 * - `ILLIXR_SWITCHBOARD_RT_THREADS`: how many (default 0: realtime callbacks share the other
+	 *   workers, and are served first).
+	 * - Their scheduling comes from the `switchboard_rt` thread_config (see common/thread_config.hpp).
+	 *   For compatibility, `ILLIXR_SWITCHBOARD_RT_PRIORITY` (a SCHED_FIFO priority) and
+	 *   `ILLIXR_SWITCHBOARD_RT_CPUS` (comma-separated CPUs) override it.
+	 */
+	struct rt_config {
+		std::size_t threads = 0;
+		thread_config sched;
+
+		static rt_config from_env() {
+			rt_config config;
+			if (const char* threads = getenv("ILLIXR_SWITCHBOARD_RT_THREADS")) {
+				config.threads = std::stoul(std::string{threads});
+			}
+			config.sched = thread_config::from_env("switchboard_rt");
+			if (const char* priority = getenv("ILLIXR_SWITCHBOARD_RT_PRIORITY")) {
+				config.sched.fifo_priority = std::stoi(std::string{priority});
+				config.sched.nice.reset();
+			}
+			if (const char* cpus = getenv("ILLIXR_SWITCHBOARD_RT_CPUS")) {
+				config.sched.cpus = thread_config::parse_cpus(cpus);
+			}
+			return config;
+		}
+	};
+
+	const std::size_t SHM_SLOTS = 64;
+	/* Slots for topics whose events vary in size, which are sized for the largest one, so fewer. */
+	const std::size_t SHM_VARIABLE_SLOTS = 8;
+	const std::size_t DEFAULT_SHM_MAX_EVENT_BYTES = 4 << 20;
+	/* How long an imported ring must be quiet before checking whether its writer replaced it. */
+	const std::chrono::milliseconds SHM_REATTACH_AFTER {500};
+	/* Component id of the subscriptions which copy exported topics into shared memory. */
+	const std::size_t SHM_EXPORT_ID = std::numeric_limits<std::size_t>::max();
+
+	/**
+	 * @brief Comma-separated topic names from the environment variable @p var.
+	 *
+	 * `ILLIXR_SHM_EXPORT` lists the topics this process copies into shared memory;
+	 * `ILLIXR_SHM_IMPORT` lists the topics this process republishes from another process's shared memory.
+	 * Only topics with a serializer qualify. Every event is encoded, copied through the segment, and
+	 * decoded (there is no zero-copy path), so camera frames cost a copy each way.
+	 */
+	static std::unordered_set<std::string> get_shm_topics(const char* var) {
+		std::unordered_set<std::string> topics;
+		const char* value = getenv(var);
+		if (value) {
+			std::istringstream stream {value};
+			std::string topic_name;
+			while (std::getline(stream, topic_name, ',')) {
+				if (!topic_name.empty()) {
+					topics.insert(topic_name);
+				}
+			}
+		}
+		return topics;
+	}
+
+	/**
+	 * @brief The largest event of a variable-size type which can go through shared memory, from
+	 * `ILLIXR_SHM_MAX_EVENT_BYTES`. Larger ones are dropped, with a warning.
+	 */
+	static std::size_t get_shm_max_event_bytes() {
+		const char* ILLIXR_SHM_MAX_EVENT_BYTES = getenv("ILLIXR_SHM_MAX_EVENT_BYTES");
+		return ILLIXR_SHM_MAX_EVENT_BYTES ? std::stoul(std::string{ILLIXR_SHM_MAX_EVENT_BYTES}) : DEFAULT_SHM_MAX_EVENT_BYTES;
+	}
+
+	/**
+	 * @brief Whether to trace events through the switchboard, from `ILLIXR_SWITCHBOARD_TRACE=y`.
+	 */
+	static bool get_trace() {
+		const char* ILLIXR_SWITCHBOARD_TRACE = getenv("ILLIXR_SWITCHBOARD_TRACE");
+		return ILLIXR_SWITCHBOARD_TRACE && std::strcmp(ILLIXR_SWITCHBOARD_TRACE, "y") == 0;
+	}
+
+	/**
+	 * @brief Replay speed, from `ILLIXR_SWITCHBOARD_REPLAY_SPEED`.
+	 *
+	 * 1 (the default) replays at the recorded rate, 2 at twice the rate, and 0 as fast as possible.
+	 */
+	static double get_replay_speed() {
+		const char* ILLIXR_SWITCHBOARD_REPLAY_SPEED = getenv("ILLIXR_SWITCHBOARD_REPLAY_SPEED");
+		return ILLIXR_SWITCHBOARD_REPLAY_SPEED ? std::stod(std::string{ILLIXR_SWITCHBOARD_REPLAY_SPEED}) : 1.0;
+	}
+
+	/* Identifies the type and its encoding, so that both ends of a segment agree on both. */
+	static std::size_t shm_type_tag(const event_type& type) {
+		return combine_layout(type.hash, type.layout);
+	}
+
+	static std::string shm_name(std::string topic_name) {
+		std::replace(topic_name.begin(), topic_name.end(), '/', '_');
+		return "/illixr_" + topic_name;
+	}
 
 	class switchboard_impl : public switchboard {
 
@@ -252,11 +1742,38 @@ namespace ILLIXR {
 
 		switchboard_impl(phonebook const* pb)
 			: _m_record_logger{pb->lookup_impl<record_logger>()}
+			, _m_shm_export{get_shm_topics("ILLIXR_SHM_EXPORT")}
+			, _m_shm_import{get_shm_topics("ILLIXR_SHM_IMPORT")}
+			, _m_trace{get_trace()}
 		{
-			for (size_t i = 0; i < MAX_THREADS; ++i) {
-				_m_threads.push_back(std::thread{[i, this]() {
+			if (const char* ILLIXR_SWITCHBOARD_RECORD = getenv("ILLIXR_SWITCHBOARD_RECORD")) {
+				_m_log = std::make_unique<event_log::writer>(ILLIXR_SWITCHBOARD_RECORD);
+			}
+			/* In executor mode, callbacks run as tasks on the runtime's executor, rather than on my own workers. */
+			const std::size_t threads = executor::enabled() ? 0 : get_switchboard_threads();
+			const rt_config rt = rt_config::from_env();
+			const thread_config worker_sched = thread_config::from_env("switchboard");
+			if (executor::enabled()) {
+				_m_queues.push_back(std::make_unique<dispatch_queue>(pb->lookup_impl<executor>()));
+			}
+			for (size_t i = 0; i < threads; ++i) {
+				_m_queues.push_back(std::make_unique<dispatch_queue>());
+			}
+			for (size_t i = 0; i < rt.threads; ++i) {
+				_m_rt_queues.push_back(std::make_unique<dispatch_queue>());
+			}
+			for (size_t i = 0; i < threads; ++i) {
+				_m_threads.push_back(std::thread{[i, worker_sched, this]() {
+					worker_sched.apply("sb_worker_" + std::to_string(i));
 					std::cout << "thread," << std::this_thread::get_id() << ",switchboard worker," << i << std::endl;
-					this->check_queues();
+					this->check_queues(*_m_queues[i]);
+				}});
+			}
+			for (size_t i = 0; i < rt.threads; ++i) {
+				_m_threads.push_back(std::thread{[i, rt, this]() {
+					rt.sched.apply("sb_rt_" + std::to_string(i));
+					std::cout << "thread," << std::this_thread::get_id() << ",switchboard realtime worker," << i << std::endl;
+					this->check_queues(*_m_rt_queues[i]);
 				}});
 			}
 		}
@@ -267,6 +1784,25 @@ namespace ILLIXR {
 				for (std::thread& thread : _m_threads) {
 					thread.join();
 				}
+				/* get_topic sees _m_terminate under the lock, so it starts no import thread after this. */
+				std::vector<std::thread> shm_threads;
+				{
+					const std::lock_guard lock{_m_registry_lock};
+					shm_threads.swap(_m_shm_threads);
+				}
+				for (std::thread& thread : shm_threads) {
+					thread.join();
+				}
+				if (_m_replay_thread.joinable()) {
+					_m_replay_thread.join();
+				}
+
+				/* Nobody will pop anymore, so release any writer blocked on a full ring. */
+				const std::lock_guard lock{_m_registry_lock};
+				for (auto& pair : _m_registry) {
+					pair.second.close();
+				}
+				std::cerr << "Drained switchboard" << std::endl;
 			}
 		}
 
@@ -274,73 +1810,353 @@ namespace ILLIXR {
 			stop();
 		}
 
+		/**
+		 * @brief Starts replaying the log named by `ILLIXR_SWITCHBOARD_REPLAY`, if any.
+		 *
+		 * Called by the runtime once every plugin is loaded, so that replay reaches all of their
+		 * subscriptions from the first event. Events are only replayed onto topics which exist by then.
+		 */
+		void start_replay() {
+			const char* ILLIXR_SWITCHBOARD_REPLAY = getenv("ILLIXR_SWITCHBOARD_REPLAY");
+			if (ILLIXR_SWITCHBOARD_REPLAY && !_m_replay_thread.joinable()) {
+				_m_replay_thread = std::thread{[this, path = std::string{ILLIXR_SWITCHBOARD_REPLAY}]() {
+					this->replay(path, get_replay_speed());
+				}};
+			}
+		}
+
 	private:
 		const std::shared_ptr<record_logger> _m_record_logger;
 
-		void check_queues() {
+		void check_queues(dispatch_queue& queue) {
 			/*
 			  Proof of thread-safety:
 			  - Reads _m_terminate using atomics, and I don't care if the value changes after this.
 			  - Modifies the queue using concurrent primitives, and I don't care if the queue changes after this.
-			  - Reads _m_registry after acquiring its lock, so it can't change while I'm reading.
-			      - In the steady state, this lock is uncontended, because its other acquirers are only called during initialization.
-			  - Calls invoke_callback, which acquires _m_callbacks_lock, (see its proof of thread-safety).
+			  - Calls subscription::invoke (see its proof of thread-safety) directly through the queued pointer,
+			    so no registry lookup or lock is needed.
+			  - No lock is held while the callback runs, so workers do not block each other.
+			  - Callback cannot call `check_queues`, because it is private to this class. Therefore, it cannot cause a deadlock
 			  Therefore this method is thread-safe.
 			 */
 			// TODO(performance): use timed deque
 			std::size_t iteration_no = 0;
 
-			record_coalescer check_queues {_m_record_logger};
-			std::pair<std::string, const void*> t;
+			__switchboard_check_queues_coalescer check_queues {_m_record_logger, __switchboard_check_queues_header};
+			subscription* t;
 
 			auto check_queues_start_cpu_time  = thread_cpu_time();
 			auto check_queues_start_wall_time = std::chrono::high_resolution_clock::now();
 			while (!_m_terminate.load()) {
 				const std::chrono::milliseconds max_wait_time {50};
-				if (_m_queue.wait_dequeue_timed(t, std::chrono::duration_cast<std::chrono::microseconds>(max_wait_time).count())) {
-					const std::lock_guard lock{_m_registry_lock};
-					check_queues.log(record{__switchboard_check_queues_header, {
-						{iteration_no},
-						{check_queues_start_cpu_time},
-						{thread_cpu_time()},
-						{check_queues_start_wall_time},
-						{std::chrono::high_resolution_clock::now()},
-					}});
+				if (queue.wait_dequeue_timed(t, std::chrono::duration_cast<std::chrono::microseconds>(max_wait_time).count())) {
+					check_queues.log(
+						iteration_no,
+						check_queues_start_cpu_time,
+						thread_cpu_time(),
+						check_queues_start_wall_time,
+						std::chrono::high_resolution_clock::now()
+					);
 					iteration_no++;
-					_m_registry.at(t.first).invoke_callbacks(t.second);
+					t->invoke();
+					t->redeem();
 					check_queues_start_cpu_time  = thread_cpu_time();
 					check_queues_start_wall_time = std::chrono::high_resolution_clock::now();
 				}
 			}
-			check_queues.log(record{__switchboard_check_queues_header, {
-				{iteration_no},
-				{check_queues_start_cpu_time},
-				{thread_cpu_time()},
-				{check_queues_start_wall_time},
-				{std::chrono::high_resolution_clock::now()},
-			}});
+			check_queues.log(
+				iteration_no,
+				check_queues_start_cpu_time,
+				thread_cpu_time(),
+				check_queues_start_wall_time,
+				std::chrono::high_resolution_clock::now()
+			);
+			/* Undelivered events are counted when stop() closes the subscriptions. */
+		}
+
+		/**
+		 * @brief Looks up (or creates) a topic. Caller must hold _m_registry_lock.
+		 *
+		 * A new topic named in ILLIXR_SHM_EXPORT or ILLIXR_SHM_IMPORT is bridged to shared memory here,
+		 * so plugins do not know whether their peers run in this process or another one.
+		 */
+		topic& get_topic(const std::string& topic_name, const event_type& type) {
+			const bool exported = _m_shm_export.count(topic_name) > 0;
+			const bool imported = _m_shm_import.count(topic_name) > 0;
+			/* Before registering the topic, so that a retry fails the same way, rather than finding it half set up. */
+			if ((exported || imported) && !type.serializable) {
+				throw std::runtime_error{"Topic " + topic_name + " cannot go through shared memory, because its type has no serializer"};
+			}
+			auto [it, inserted] = _m_registry.try_emplace(topic_name, _m_record_logger, type, topic_name);
+			topic& topic = it->second;
+			assert(topic.ty() == type.hash);
+			if (inserted) {
+				if (_m_log) {
+					if (type.serializable) {
+						topic.record_to(*_m_log);
+					} else {
+						std::cerr << "Not recording topic " << topic_name << ", because its type has no serializer" << std::endl;
+					}
+				}
+				if (_m_trace) {
+					topic.trace();
+				}
+				if (exported) {
+					export_shm(topic);
+				}
+				if (imported && !_m_terminate.load()) {
+					_m_shm_threads.push_back(std::thread{[this, &topic]() {
+						this->import_shm(topic);
+					}});
+				}
+			}
+			return topic;
+		}
+
+		void export_shm(topic& topic) {
+			/*
+			  Proof of thread-safety:
+			  - Only called from get_topic, under _m_registry_lock.
+			  - The ring has one writer, because a subscription's callbacks run one at a time (see subscription).
+			 */
+			const event_type& type = topic.type();
+			const bool fixed = type.fixed_size != 0;
+			auto ring = std::make_shared<shm_ring>(shm_ring::create(shm_name(topic.name()), shm_type_tag(type),
+				fixed ? type.fixed_size : get_shm_max_event_bytes(), fixed ? SHM_SLOTS : SHM_VARIABLE_SLOTS));
+			/* Drop rather than block, so a slow segment never stalls the local publisher. */
+			topic.schedule(SHM_EXPORT_ID, [ring, &type, name = topic.name(), warned = false](const std::shared_ptr<const void>& event) mutable {
+				const std::size_t size = type.encoded_size(event.get());
+				if (size > ring->event_size()) {
+					if (!warned) {
+						warned = true;
+						std::cerr << "Not exporting events of " << size << " bytes on " << name << " to shared memory; raise ILLIXR_SHM_MAX_EVENT_BYTES" << std::endl;
+					}
+					return;
+				}
+				ring->write_with(size, [&](void* slot) {
+					type.encode(event.get(), slot);
+				});
+			}, next_queue(priority_class::normal), queue_policy{queue_policy{}.capacity, overflow_policy::drop_oldest});
+		}
+
+		/**
+		 * @brief Opens the segment @p name into @p ring, waiting for its writer to create it.
+		 *
+		 * @return false if switchboard stopped first, or the segment cannot be used.
+		 */
+		bool open_shm(const std::string& name, const event_type& type, shm_ring& ring) {
+			try {
+				while (!shm_ring::open(name, shm_type_tag(type), type.fixed_size, ring)) {
+					/* The exporting process may not have started (or restarted) yet. */
+					if (_m_terminate.load()) {
+						return false;
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds{50});
+				}
+			} catch (const std::runtime_error& e) {
+				std::cerr << "Not importing " << name << ": " << e.what() << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		void import_shm(topic& topic) {
+			/*
+			  Proof of thread-safety:
+			  - Reads _m_terminate using atomics. stop() joins this thread before closing topics, and the registry
+			    (which owns topic) outlives stop().
+			  - Publishes through a topic writer (see its proof of thread-safety).
+			  - Only this thread reads the ring, through its own cursor.
+			 */
+			const event_type& type = topic.type();
+			const std::string name = shm_name(topic.name());
+			shm_ring ring;
+			if (!open_shm(name, type, ring)) {
+				return;
+			}
+			set_thread_name("sb_shm_" + topic.name());
+			std::cout << "thread," << std::this_thread::get_id() << ",switchboard shm import," << topic.name() << std::endl;
+
+			const std::unique_ptr<writer<void>> writer = topic.get_writer();
+			const std::shared_ptr<event_pool> pool = writer->get_pool();
+			std::vector<char> buffer (ring.event_size());
+			std::size_t size = 0;
+			/* Start from the events published after I joined, like a local reader would. */
+			std::uint64_t next = ring.published();
+			std::size_t lapped = 0;
+			/* When the ring last delivered an event, or was last checked for a replacement. */
+			auto last_seen = std::chrono::steady_clock::now();
+			bool attached = true;
+			while (attached && !_m_terminate.load()) {
+				switch (ring.read(next, buffer.data(), size)) {
+				case shm_ring::read_result::ok:
+					last_seen = std::chrono::steady_clock::now();
+					if (std::shared_ptr<void> event = type.decode(buffer.data(), size, pool)) {
+						writer->put(std::move(event));
+					}
+					break;
+				case shm_ring::read_result::empty:
+					/* A quiet ring may be one whose writer restarted, and replaced the segment with a new
+					   one. Checking costs a system call, so only once it has been quiet for a while. */
+					if (std::chrono::steady_clock::now() - last_seen > SHM_REATTACH_AFTER) {
+						last_seen = std::chrono::steady_clock::now();
+						if (ring.replaced()) {
+							if (!open_shm(name, type, ring)) {
+								attached = false;
+								break;
+							}
+							/* Everything in the new segment is newer than what I read from the old one. */
+							next = 0;
+							buffer.resize(ring.event_size());
+							std::cerr << "Reattached to " << name << " after its writer replaced it" << std::endl;
+						}
+					}
+					ring.wait(next, std::chrono::milliseconds{50});
+					break;
+				case shm_ring::read_result::lapped:
+					lapped++;
+					break;
+				}
+			}
+			if (lapped > 0) {
+				std::cerr << "Lost events " << lapped << " times while importing " << topic.name() << " from shared memory" << std::endl;
+			}
+		}
+
+		void replay(const std::string& path, double speed) {
+			/*
+			  Proof of thread-safety:
+			  - Reads _m_terminate using atomics. stop() joins this thread before closing topics.
+			  - Reads _m_registry after acquiring its lock, once per recorded topic.
+			  - Publishes through topic writers (see their proof of thread-safety).
+			  - The log reader is only used by this thread.
+			 */
+			event_log::reader log {path};
+			/* Indexed by recorded topic id. Null if the topic does not exist here, or has another type. */
+			std::vector<std::unique_ptr<writer<void>>> writers;
+			std::vector<const event_type*> types;
+			std::vector<bool> resolved;
+			std::vector<char> buffer;
+			std::uint32_t topic_id;
+			std::chrono::nanoseconds time;
+			std::size_t replayed = 0;
+			std::size_t malformed = 0;
+			const auto start = std::chrono::steady_clock::now();
+			set_thread_name("sb_replay");
+			std::cout << "thread," << std::this_thread::get_id() << ",switchboard replay," << path << std::endl;
 
-			while (_m_queue.try_dequeue(t)) {
-				_m_registry.at(t.first).mark_unprocessed(t.second);
+			while (!_m_terminate.load() && log.next(topic_id, time, buffer)) {
+				if (topic_id >= writers.size()) {
+					writers.resize(topic_id + 1);
+					types.resize(topic_id + 1);
+					resolved.resize(topic_id + 1);
+				}
+				if (!resolved[topic_id]) {
+					resolved[topic_id] = true;
+					const event_log::reader::topic& recorded = log.get_topic(topic_id);
+					const std::lock_guard lock{_m_registry_lock};
+					auto it = _m_registry.find(recorded.name);
+					if (it != _m_registry.end()) {
+						if (it->second.ty() != recorded.type_hash) {
+							std::cerr << "Not replaying topic " << recorded.name << ", because it was recorded with another type" << std::endl;
+						} else if (it->second.type().layout != recorded.layout) {
+							std::cerr << "Not replaying topic " << recorded.name << ", because its type's layout changed since it was recorded" << std::endl;
+						} else {
+							writers[topic_id] = it->second.get_writer();
+							types[topic_id] = &it->second.type();
+						}
+					}
+				}
+				writer<void>* const writer = writers[topic_id].get();
+				if (!writer) {
+					continue;
+				}
+
+				if (speed > 0) {
+					const auto target = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(time / speed);
+					/* Sleep in slices, so stop() need not wait for a long gap in the recording. */
+					while (!_m_terminate.load() && std::chrono::steady_clock::now() < target) {
+						std::this_thread::sleep_until(std::min(target, std::chrono::steady_clock::now() + std::chrono::milliseconds{50}));
+					}
+				}
+				std::shared_ptr<void> event = types[topic_id]->decode(buffer.data(), buffer.size(), writer->get_pool());
+				if (!event) {
+					malformed++;
+					continue;
+				}
+				writer->put(std::move(event));
+				replayed++;
+			}
+			std::cerr << "Replayed " << replayed << " events from " << path;
+			if (malformed > 0) {
+				std::cerr << " (skipped " << malformed << " which did not decode)";
 			}
-			std::cerr << "Drained switchboard" << std::endl;
+			std::cerr << std::endl;
 		}
 
-		virtual void _p_schedule(std::size_t component_id, const std::string& topic_name, std::function<void(const void*)> callback, std::size_t ty) override {
+		/**
+		 * @brief Picks the worker for a new subscription. Caller must hold _m_registry_lock.
+		 *
+		 * Spreads subscriptions round-robin, so that a slow one only delays those sharing its worker.
+		 * Realtime subscriptions go to the dedicated workers, if there are any.
+		 */
+		dispatch_queue& next_queue(priority_class priority) {
+			if (priority == priority_class::realtime && !_m_rt_queues.empty()) {
+				dispatch_queue& queue = *_m_rt_queues[_m_next_rt_queue];
+				_m_next_rt_queue = (_m_next_rt_queue + 1) % _m_rt_queues.size();
+				return queue;
+			}
+			dispatch_queue& queue = *_m_queues[_m_next_queue];
+			_m_next_queue = (_m_next_queue + 1) % _m_queues.size();
+			return queue;
+		}
+
+		virtual void _p_schedule(std::size_t component_id, const std::string& topic_name, std::function<void(const std::shared_ptr<const void>&)> callback, const event_type& type, queue_policy policy) override {
 			/*
 			  Proof of thread-safety:
 			  - Reads _m_registry after acquiring its lock (it can't change)
-			      - This method is only called during initialization.
+			      - This lock is not on the put/dispatch path, so calling this at runtime (even from a callback) does not stall events.
 			  - Calls topic.schedule, which acquires _m_callbacks_lock, (see its proof of thread-safety)
+			  - Calls next_queue under _m_registry_lock.
+			  - Reads _m_terminate using atomics. stop() closes topics under _m_registry_lock, so either it
+			    closes this subscription, or I see _m_terminate and close it myself.
 			  Therefore this method is thread-safe.
 			 */
 			const std::lock_guard lock{_m_registry_lock};
-			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, ty, topic_name, _m_queue).first->second;
-			assert(topic.ty() == ty);
-			topic.schedule(component_id, callback);
+			topic& topic = get_topic(topic_name, type);
+			topic.schedule(component_id, subscription::callback_type{callback}, next_queue(policy.priority), policy);
+			if (_m_terminate.load()) {
+				topic.close();
+			}
 		}
 
-		virtual std::unique_ptr<writer<void>> _p_publish(const std::string& topic_name, std::size_t ty) override {
+		virtual void _p_schedule_batch(std::size_t component_id, const std::string& topic_name, std::function<void(const std::shared_ptr<const void>*, std::size_t)> callback, const event_type& type, std::size_t max_batch, queue_policy policy) override {
+			/*
+			  Proof of thread-safety: same as _p_schedule.
+			 */
+			const std::lock_guard lock{_m_registry_lock};
+			topic& topic = get_topic(topic_name, type);
+			topic.schedule(component_id, subscription::batch_callback_type{callback}, max_batch, next_queue(policy.priority), policy);
+			if (_m_terminate.load()) {
+				topic.close();
+			}
+		}
+
+		virtual void _p_unschedule(std::size_t component_id, const std::string& topic_name) override {
+			/*
+			  Proof of thread-safety:
+			  - Reads _m_registry after acquiring its lock.
+			  - Calls topic.unschedule, which acquires _m_callbacks_lock, (see its proof of thread-safety)
+			  Therefore this method is thread-safe.
+			 */
+			const std::lock_guard lock{_m_registry_lock};
+			auto it = _m_registry.find(topic_name);
+			if (it != _m_registry.end()) {
+				it->second.unschedule(component_id);
+			}
+		}
+
+		virtual std::unique_ptr<writer<void>> _p_publish(const std::string& topic_name, const event_type& type) override {
 			/*
 			  Proof of thread-safety:
 			  - All accesses _m_registry occur after acquiring its lock
@@ -350,15 +2166,57 @@ namespace ILLIXR {
 			  Therefore this method is thread-safe.
 			 */
 			const std::lock_guard lock{_m_registry_lock};
-			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, ty, topic_name, _m_queue).first->second;
-			assert(topic.ty() == ty);
+			topic& topic = get_topic(topic_name, type);
 			return std::unique_ptr<writer<void>>(topic.get_writer().release());
 			/* TODO: (code beautify) why can't I write
 			   return std::move(topic.get_writer());
 			*/
 		}
 
-		virtual std::unique_ptr<reader_latest<void>> _p_subscribe_latest(const std::string& topic_name, std::size_t ty) override {
+		virtual std::unique_ptr<reader<void>> _p_subscribe(const std::string& topic_name, const event_type& type) override {
+			/*
+			  Proof of thread-safety:
+			  - All accesses _m_registry occur after acquiring its lock
+			      - This method is only called during initialization, so no steady-state contention.
+			      - Does not acquire _m_callbacks_lock
+			  - Returns a reader handle (see its proof of thread-safety)
+			  Therefore this method is thread-safe.
+			 */
+			const std::lock_guard lock{_m_registry_lock};
+			topic& topic = get_topic(topic_name, type);
+			return std::unique_ptr<reader<void>>(topic.get_reader().release());
+		}
+
+		virtual std::vector<topic_stats> get_topic_stats() override {
+			/*
+			  Proof of thread-safety:
+			  - Reads _m_registry after acquiring its lock.
+			  - Calls topic.stats (see its proof of thread-safety).
+			  Therefore this method is thread-safe.
+			 */
+			const std::lock_guard lock{_m_registry_lock};
+			std::vector<topic_stats> stats;
+			stats.reserve(_m_registry.size());
+			for (auto& pair : _m_registry) {
+				stats.push_back(pair.second.stats());
+			}
+			return stats;
+		}
+
+		virtual std::unique_ptr<buffered_reader<void>> _p_subscribe_buffered(const std::string& topic_name, const event_type& type, std::size_t capacity, std::chrono::nanoseconds max_age, std::chrono::system_clock::time_point (*time_of)(const void*)) override {
+			/*
+			  Proof of thread-safety:
+			  - All accesses _m_registry occur after acquiring its lock
+			      - This method is only called during initialization, so no steady-state contention.
+			  - Calls topic.get_buffered_reader, which acquires _m_callbacks_lock, (see its proof of thread-safety)
+			  Therefore this method is thread-safe.
+			 */
+			const std::lock_guard lock{_m_registry_lock};
+			topic& topic = get_topic(topic_name, type);
+			return std::unique_ptr<buffered_reader<void>>(topic.get_buffered_reader(capacity, max_age, time_of).release());
+		}
+
+		virtual std::unique_ptr<reader_latest<void>> _p_subscribe_latest(const std::string& topic_name, const event_type& type) override {
 			/*
 			  Proof of thread-safety:
 			  - All accesses _m_registry occur after acquiring its lock
@@ -368,19 +2226,32 @@ namespace ILLIXR {
 			  Therefore this method is thread-safe.
 			 */
 			const std::lock_guard lock{_m_registry_lock};
-			topic& topic = _m_registry.try_emplace(topic_name, _m_record_logger, ty, topic_name, _m_queue).first->second;
-			assert(topic.ty() == ty);
+			topic& topic = get_topic(topic_name, type);
 			return std::unique_ptr<reader_latest<void>>(topic.get_reader_latest().release());
 			/* TODO: (code beautify) why can't I write
 			   return std::move(topic.get_reader_latest());
 			*/
 		}
 
+		/* Declared before _m_registry, since topics append to it until they are destroyed. */
+		std::unique_ptr<event_log::writer> _m_log;
 		std::unordered_map<std::string, topic> _m_registry;
 		std::mutex _m_registry_lock;
 		std::vector<std::thread> _m_threads;
 		std::atomic<bool> _m_terminate {false};
-		queue<std::pair<std::string, const void*>> _m_queue;
+		/* One queue per worker. Sized before the workers start, and never resized. */
+		std::vector<std::unique_ptr<dispatch_queue>> _m_queues;
+		std::size_t _m_next_queue = 0;
+		/* Queues of the workers dedicated to realtime callbacks. Possibly empty. */
+		std::vector<std::unique_ptr<dispatch_queue>> _m_rt_queues;
+		std::size_t _m_next_rt_queue = 0;
+		const std::unordered_set<std::string> _m_shm_export;
+		const std::unordered_set<std::string> _m_shm_import;
+		/* ILLIXR_SWITCHBOARD_TRACE: log the latency of every hop between topics (see topic::trace). */
+		const bool _m_trace;
+		/* One per imported topic. Guarded by _m_registry_lock until stop() joins them. */
+		std::vector<std::thread> _m_shm_threads;
+		std::thread _m_replay_thread;
 
 	};
 
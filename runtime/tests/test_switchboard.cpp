@@ -0,0 +1,1369 @@
+#include <gtest/gtest.h>
+
+#include "../noop_record_logger.hpp"
+#include "../switchboard_impl.hpp"
+#include "../../common/threadloop.hpp"
+
+namespace ILLIXR {
+
+class ILLIXRSwitchboard : public ::testing::Test {
+protected:
+	ILLIXRSwitchboard() {
+		pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+		sb = create_switchboard(&pb);
+	}
+
+	~ILLIXRSwitchboard() {
+		sb->stop();
+	}
+
+	phonebook pb;
+	std::shared_ptr<switchboard> sb;
+};
+
+/* Scheduled callbacks run on switchboard's thread, so give them a moment to catch up. */
+template <typename Predicate>
+bool eventually(Predicate pred) {
+	for (std::size_t tries = 0; tries < 100; ++tries) {
+		if (pred()) {
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+	}
+	return pred();
+}
+
+typedef struct {
+	std::size_t seq;
+	double payload[8];
+} test_event;
+
+template <>
+struct serializer<test_event> : trivial_serializer<test_event> { };
+
+TEST_F(ILLIXRSwitchboard, LatestIsNullBeforePut) {
+	auto reader = sb->subscribe_latest<test_event>("topic");
+	ASSERT_EQ(reader->get_latest_ro(), nullptr);
+}
+
+TEST_F(ILLIXRSwitchboard, GetLatestRo) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe_latest<test_event>("topic");
+
+	for (std::size_t i = 0; i < 3; ++i) {
+		auto ev = writer->allocate();
+		ev->seq = i;
+		writer->put(ev);
+		ASSERT_EQ(reader->get_latest_ro()->seq, i);
+	}
+}
+
+TEST_F(ILLIXRSwitchboard, ReaderKeepsEventAlive) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe_latest<test_event>("topic");
+
+	auto ev = writer->allocate();
+	ev->seq = 1;
+	writer->put(ev);
+	ev.reset();
+
+	std::shared_ptr<const test_event> held = reader->get_latest_ro();
+	for (std::size_t i = 2; i < 10; ++i) {
+		auto newer = writer->allocate();
+		newer->seq = i;
+		writer->put(newer);
+	}
+	ASSERT_EQ(held->seq, 1);
+}
+
+TEST_F(ILLIXRSwitchboard, AllocateRecyclesBlocks) {
+	auto writer = sb->publish<test_event>("topic");
+
+	const test_event* first = writer->allocate().get();
+	// The block was released as soon as the temporary died; the next allocation should reuse it.
+	const test_event* second = writer->allocate().get();
+	ASSERT_EQ(first, second);
+}
+
+class counted_event {
+public:
+	counted_event() { ++alive; }
+	~counted_event() { --alive; }
+	static std::atomic<int> alive;
+};
+std::atomic<int> counted_event::alive {0};
+
+TEST_F(ILLIXRSwitchboard, PutTakesOwnership) {
+	auto writer = sb->publish<counted_event>("topic");
+	auto reader = sb->subscribe_latest<counted_event>("topic");
+
+	writer->put(new counted_event);
+	writer->put(writer->allocate());
+	ASSERT_TRUE(eventually([] { return counted_event::alive.load() == 1; }));
+
+	std::shared_ptr<const counted_event> held = reader->get_latest_ro();
+	writer->put(new counted_event);
+	ASSERT_TRUE(eventually([] { return counted_event::alive.load() == 2; }));
+
+	held.reset();
+	ASSERT_EQ(counted_event::alive.load(), 1);
+}
+
+TEST_F(ILLIXRSwitchboard, ScheduleReleasesEvents) {
+	auto writer = sb->publish<counted_event>("topic");
+	std::atomic<std::size_t> calls {0};
+	sb->schedule<counted_event>(0, "topic", [&](const counted_event*) {
+		++calls;
+	});
+
+	const std::size_t n = 50;
+	for (std::size_t i = 0; i < n; ++i) {
+		writer->put(writer->allocate());
+	}
+	ASSERT_TRUE(eventually([&] { return calls.load() == n; }));
+	sb->stop();
+
+	// Only the latest event is still referenced.
+	ASSERT_EQ(counted_event::alive.load(), 1);
+}
+
+TEST_F(ILLIXRSwitchboard, ScheduleSeesEveryEventInOrder) {
+	auto writer = sb->publish<test_event>("topic");
+
+	const std::size_t n = 100;
+	std::vector<std::size_t> seen;
+	std::mutex seen_lock;
+	sb->schedule<test_event>(0, "topic", [&](const test_event* ev) {
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		seen.push_back(ev->seq);
+	});
+
+	for (std::size_t i = 0; i < n; ++i) {
+		auto ev = writer->allocate();
+		ev->seq = i;
+		writer->put(ev);
+	}
+
+	ASSERT_TRUE(eventually([&] {
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		return seen.size() == n;
+	}));
+
+	const std::lock_guard<std::mutex> lock{seen_lock};
+	for (std::size_t i = 0; i < n; ++i) {
+		ASSERT_EQ(seen[i], i);
+	}
+}
+
+
+TEST_F(ILLIXRSwitchboard, SlowSubscriberDoesNotBlockOthers) {
+	setenv("ILLIXR_SWITCHBOARD_THREADS", "2", true);
+	sb->stop();
+	sb = create_switchboard(&pb);
+	unsetenv("ILLIXR_SWITCHBOARD_THREADS");
+
+	auto writer = sb->publish<test_event>("topic");
+	std::atomic<bool> release {false};
+	std::atomic<std::size_t> fast_calls {0};
+	sb->schedule<test_event>(0, "topic", [&](const test_event*) {
+		while (!release) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+	});
+	sb->schedule<test_event>(1, "topic", [&](const test_event*) {
+		++fast_calls;
+	});
+
+	const std::size_t n = 10;
+	for (std::size_t i = 0; i < n; ++i) {
+		writer->put(writer->allocate());
+	}
+	// The fast subscriber is on the other worker, so it keeps up while the slow one is stuck.
+	EXPECT_TRUE(eventually([&] { return fast_calls.load() == n; }));
+	release = true;
+	// The callbacks refer to locals, so join the workers before they go out of scope.
+	sb->stop();
+}
+
+/* Publish n events while the only subscriber is stuck on the first one, then let it go. */
+std::vector<std::size_t> deliver_while_stalled(switchboard& sb, queue_policy policy, std::size_t n) {
+	auto writer = sb.publish<test_event>("topic");
+	std::atomic<bool> release {false};
+	std::atomic<bool> started {false};
+	std::vector<std::size_t> seen;
+	std::mutex seen_lock;
+	sb.schedule<test_event>(0, "topic", [&](const test_event* ev) {
+		started = true;
+		while (!release) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		seen.push_back(ev->seq);
+	}, policy);
+
+	auto put = [&](std::size_t seq) {
+		auto ev = writer->allocate();
+		ev->seq = seq;
+		writer->put(ev);
+	};
+	put(0);
+	EXPECT_TRUE(eventually([&] { return started.load(); }));
+	for (std::size_t i = 1; i < n; ++i) {
+		put(i);
+	}
+	release = true;
+	eventually([&] {
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		return seen.size() == std::min(n, policy.capacity + 1);
+	});
+	sb.stop();
+	return seen;
+}
+
+TEST_F(ILLIXRSwitchboard, DropOldestKeepsLatest) {
+	auto seen = deliver_while_stalled(*sb, {2, overflow_policy::drop_oldest}, 10);
+	ASSERT_EQ(seen, (std::vector<std::size_t>{0, 8, 9}));
+}
+
+TEST_F(ILLIXRSwitchboard, DropNewestKeepsEarliest) {
+	auto seen = deliver_while_stalled(*sb, {2, overflow_policy::drop_newest}, 10);
+	ASSERT_EQ(seen, (std::vector<std::size_t>{0, 1, 2}));
+}
+
+TEST_F(ILLIXRSwitchboard, BlockLosesNothing) {
+	auto writer = sb->publish<test_event>("topic");
+	std::vector<std::size_t> seen;
+	std::mutex seen_lock;
+	sb->schedule<test_event>(0, "topic", [&](const test_event* ev) {
+		std::this_thread::sleep_for(std::chrono::microseconds{100});
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		seen.push_back(ev->seq);
+	}, {2, overflow_policy::block});
+
+	const std::size_t n = 50;
+	for (std::size_t i = 0; i < n; ++i) {
+		auto ev = writer->allocate();
+		ev->seq = i;
+		writer->put(ev);
+	}
+	ASSERT_TRUE(eventually([&] {
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		return seen.size() == n;
+	}));
+	const std::lock_guard<std::mutex> lock{seen_lock};
+	for (std::size_t i = 0; i < n; ++i) {
+		ASSERT_EQ(seen[i], i);
+	}
+}
+
+TEST_F(ILLIXRSwitchboard, CallbackCanPublishAndSchedule) {
+	auto first = sb->publish<test_event>("first");
+	auto second = sb->publish<test_event>("second");
+	std::atomic<std::size_t> forwarded {0};
+	sb->schedule<test_event>(0, "first", [&](const test_event* ev) {
+		if (ev->seq == 0) {
+			sb->schedule<test_event>(1, "second", [&](const test_event*) {
+				++forwarded;
+			});
+		}
+		auto out = second->allocate();
+		out->seq = ev->seq;
+		second->put(out);
+	});
+
+	for (std::size_t i = 0; i < 10; ++i) {
+		auto ev = first->allocate();
+		ev->seq = i;
+		first->put(ev);
+	}
+	// The subscription to "second" may miss the first event or so, depending on when it lands.
+	ASSERT_TRUE(eventually([&] { return forwarded.load() >= 9; }));
+}
+
+TEST_F(ILLIXRSwitchboard, UnscheduleStopsCallbacks) {
+	auto writer = sb->publish<test_event>("topic");
+	std::atomic<std::size_t> kept {0};
+	std::atomic<std::size_t> removed {0};
+	sb->schedule<test_event>(0, "topic", [&](const test_event*) { ++kept; });
+	sb->schedule<test_event>(1, "topic", [&](const test_event*) { ++removed; });
+
+	writer->put(writer->allocate());
+	ASSERT_TRUE(eventually([&] { return kept.load() == 1 && removed.load() == 1; }));
+
+	sb->unschedule(1, "topic");
+	writer->put(writer->allocate());
+	ASSERT_TRUE(eventually([&] { return kept.load() == 2; }));
+	ASSERT_EQ(removed.load(), 1);
+}
+
+/* Stands in for a switchboard worker (see switchboard_impl::check_queues). */
+static void redeem_all(dispatch_queue& queue) {
+	subscription* sub;
+	while (queue.wait_dequeue_timed(sub, 0)) {
+		sub->invoke();
+		sub->redeem();
+	}
+}
+
+TEST(ILLIXRTopic, UnscheduleReclaimsSubscriptionsAndSnapshots) {
+	topic t {std::make_shared<noop_record_logger>(), event_type::of<test_event>(), "topic"};
+	dispatch_queue queue;
+	const auto writer = t.get_writer();
+	std::size_t kept = 0;
+	std::size_t removed = 0;
+	t.schedule(0, subscription::callback_type{[&](const std::shared_ptr<const void>&) { ++kept; }}, queue, queue_policy{});
+
+	for (std::size_t i = 1; i <= 1000; ++i) {
+		t.schedule(i, subscription::callback_type{[&](const std::shared_ptr<const void>&) { ++removed; }}, queue, queue_policy{});
+		writer->put(std::make_shared<test_event>());
+		/* Its token is still queued, so it must outlive this. */
+		t.unschedule(i);
+		redeem_all(queue);
+		ASSERT_LE(t.retained().first, 2);
+		ASSERT_LE(t.retained().second, 1);
+	}
+	/* The last one is freed once something looks again. */
+	const topic_stats stats = t.stats();
+	ASSERT_EQ(t.retained(), (std::pair<std::size_t, std::size_t>{1, 0}));
+	ASSERT_EQ(kept, 1000);
+	/* The removed subscriptions' counters survive them. */
+	ASSERT_EQ(stats.processed, kept + removed);
+	ASSERT_EQ(stats.processed + stats.unprocessed, 2000);
+	ASSERT_EQ(stats.callbacks, 1);
+}
+
+TEST(ILLIXRTopic, ReclaimWaitsForConcurrentWriters) {
+	topic t {std::make_shared<noop_record_logger>(), event_type::of<test_event>(), "topic"};
+	dispatch_queue queue;
+	std::atomic<bool> done {false};
+	std::thread writer_thread {[&] {
+		const auto writer = t.get_writer();
+		while (!done.load()) {
+			writer->put(std::make_shared<test_event>());
+		}
+	}};
+	std::thread worker {[&] {
+		subscription* sub;
+		while (!done.load()) {
+			if (queue.wait_dequeue_timed(sub, 1000)) {
+				sub->invoke();
+				sub->redeem();
+			}
+		}
+	}};
+	for (std::size_t i = 0; i < 2000; ++i) {
+		t.schedule(i, subscription::callback_type{[](const std::shared_ptr<const void>&) { }}, queue, queue_policy{});
+		t.unschedule(i);
+	}
+	done = true;
+	writer_thread.join();
+	worker.join();
+	redeem_all(queue);
+	t.stats();
+	ASSERT_EQ(t.retained(), (std::pair<std::size_t, std::size_t>{0, 0}));
+}
+
+TEST_F(ILLIXRSwitchboard, GetLatestCopiesWhenShared) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe_latest<test_event>("topic");
+	auto other = sb->subscribe_latest<test_event>("topic");
+	ASSERT_EQ(reader->get_latest(), nullptr);
+
+	auto ev = writer->allocate();
+	ev->seq = 1;
+	writer->put(ev);
+	ev.reset();
+
+	std::shared_ptr<test_event> mine = reader->get_latest();
+	mine->seq = 2;
+	ASSERT_EQ(other->get_latest_ro()->seq, 1);
+	ASSERT_NE(mine.get(), other->get_latest_ro().get());
+}
+
+TEST_F(ILLIXRSwitchboard, GetLatestHandsOverToSoleReader) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe_latest<test_event>("topic");
+
+	auto ev = writer->allocate();
+	const test_event* published = ev.get();
+	writer->put(ev);
+	ev.reset();
+
+	std::shared_ptr<test_event> mine = reader->get_latest();
+	ASSERT_EQ(mine.get(), published);
+	// It was taken out of the topic, so a reader which comes along later cannot see my changes.
+	mine->seq = 2;
+	auto later = sb->subscribe_latest<test_event>("topic");
+	ASSERT_EQ(later->get_latest_ro(), nullptr);
+	ASSERT_EQ(reader->get_latest_ro(), nullptr);
+}
+
+TEST_F(ILLIXRSwitchboard, WaitNextTimesOut) {
+	auto reader = sb->subscribe<test_event>("topic");
+	ASSERT_EQ(reader->wait_next(std::chrono::milliseconds{10}), nullptr);
+	ASSERT_EQ(reader->seq(), 0);
+}
+
+TEST_F(ILLIXRSwitchboard, WaitNextWakesOnPut) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe<test_event>("topic");
+
+	std::thread producer {[&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{20});
+		auto ev = writer->allocate();
+		ev->seq = 7;
+		writer->put(ev);
+	}};
+	auto ev = reader->wait_next(std::chrono::seconds{5});
+	producer.join();
+	ASSERT_NE(ev, nullptr);
+	ASSERT_EQ(ev->seq, 7);
+	ASSERT_EQ(reader->seq(), 1);
+
+	// Already returned, so there is nothing new.
+	ASSERT_EQ(reader->wait_next(std::chrono::milliseconds{10}), nullptr);
+}
+
+TEST_F(ILLIXRSwitchboard, WaitUntilSeq) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe<test_event>("topic");
+
+	std::thread producer {[&] {
+		for (std::size_t i = 1; i <= 5; ++i) {
+			auto ev = writer->allocate();
+			ev->seq = i;
+			writer->put(ev);
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+	}};
+	auto ev = reader->wait_until(5, std::chrono::seconds{5});
+	producer.join();
+	ASSERT_NE(ev, nullptr);
+	ASSERT_EQ(ev->seq, 5);
+	ASSERT_EQ(reader->seq(), 5);
+}
+
+struct timed_event {
+	std::chrono::system_clock::time_point time;
+	double value;
+};
+
+template <>
+struct event_time<timed_event> {
+	static std::chrono::system_clock::time_point get(const timed_event& ev) { return ev.time; }
+};
+
+class ILLIXRSwitchboardBuffered : public ILLIXRSwitchboard {
+protected:
+	const std::chrono::system_clock::time_point t0 {std::chrono::seconds{1000}};
+
+	/* Publishes values 0, 1, ..., n - 1 at t0 + 0ms, t0 + 10ms, .... */
+	void publish(std::size_t n) {
+		auto writer = sb->publish<timed_event>("topic");
+		for (std::size_t i = 0; i < n; ++i) {
+			auto ev = writer->allocate();
+			*ev = timed_event{t0 + std::chrono::milliseconds{10 * i}, double(i)};
+			writer->put(ev);
+		}
+	}
+
+	static std::vector<double> values(const std::vector<std::shared_ptr<const timed_event>>& events) {
+		std::vector<double> ret;
+		for (const auto& ev : events) {
+			ret.push_back(ev->value);
+		}
+		return ret;
+	}
+};
+
+TEST_F(ILLIXRSwitchboardBuffered, KeepsLastN) {
+	auto reader = sb->subscribe_buffered<timed_event>("topic", 4);
+	publish(10);
+	ASSERT_EQ(values(reader->get_last(100)), (std::vector<double>{6, 7, 8, 9}));
+	ASSERT_EQ(values(reader->get_last(2)), (std::vector<double>{8, 9}));
+}
+
+TEST_F(ILLIXRSwitchboardBuffered, KeepsLastDuration) {
+	auto reader = sb->subscribe_buffered<timed_event>("topic", 100, std::chrono::milliseconds{25});
+	publish(10);
+	ASSERT_EQ(values(reader->get_last(100)), (std::vector<double>{7, 8, 9}));
+}
+
+TEST_F(ILLIXRSwitchboardBuffered, GetRange) {
+	auto reader = sb->subscribe_buffered<timed_event>("topic", 100);
+	publish(10);
+	auto range = reader->get_range(t0 + std::chrono::milliseconds{15}, t0 + std::chrono::milliseconds{40});
+	ASSERT_EQ(values(range), (std::vector<double>{2, 3, 4}));
+	ASSERT_TRUE(reader->get_range(t0 + std::chrono::seconds{1}, t0 + std::chrono::seconds{2}).empty());
+}
+
+TEST_F(ILLIXRSwitchboardBuffered, Interpolate) {
+	auto reader = sb->subscribe_buffered<timed_event>("topic", 100);
+	publish(10);
+	auto lerp = [](const timed_event& a, const timed_event& b, double alpha) {
+		return timed_event{a.time, a.value + alpha * (b.value - a.value)};
+	};
+	auto mid = reader->interpolate(t0 + std::chrono::milliseconds{25}, lerp);
+	ASSERT_TRUE(mid);
+	ASSERT_DOUBLE_EQ(mid->value, 2.5);
+
+	auto exact = reader->interpolate(t0 + std::chrono::milliseconds{30}, lerp);
+	ASSERT_TRUE(exact);
+	ASSERT_DOUBLE_EQ(exact->value, 3);
+
+	ASSERT_FALSE(reader->interpolate(t0 + std::chrono::seconds{1}, lerp));
+}
+
+TEST_F(ILLIXRSwitchboard, TopicStats) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe_latest<test_event>("topic");
+	std::atomic<std::size_t> calls {0};
+	sb->schedule<test_event>(0, "topic", [&](const test_event*) { ++calls; });
+
+	const std::size_t n = 20;
+	for (std::size_t i = 0; i < n; ++i) {
+		writer->put(writer->allocate());
+	}
+	auto all = sb->get_topic_stats();
+	ASSERT_EQ(all.size(), 1);
+	ASSERT_GT(all[0].publish_rate, 0);
+
+	// Counters are updated just after each callback returns.
+	topic_stats stats;
+	ASSERT_TRUE(eventually([&] {
+		stats = sb->get_topic_stats()[0];
+		return stats.processed == n;
+	}));
+	ASSERT_EQ(stats.name, "topic");
+	ASSERT_EQ(stats.type_hash, typeid(test_event).hash_code());
+	ASSERT_EQ(stats.writers, 1);
+	ASSERT_EQ(stats.readers, 1);
+	ASSERT_EQ(stats.callbacks, 1);
+	ASSERT_EQ(stats.published, n);
+	ASSERT_EQ(stats.queue_depth, 0);
+	ASSERT_EQ(stats.processed, n);
+	ASSERT_EQ(stats.dropped_oldest + stats.dropped_newest, 0);
+	std::size_t deliveries = 0;
+	for (std::size_t count : stats.callback_latency_us) {
+		deliveries += count;
+	}
+	ASSERT_EQ(deliveries, n);
+
+	// Reading the stats does not reset the rate, so pollers do not disturb each other.
+	ASSERT_GT(sb->get_topic_stats()[0].publish_rate, 0);
+}
+
+TEST(ShmRing, ReadsInOrderAndReportsLaps) {
+	const std::string name = "/illixr_test_ring_" + std::to_string(getpid());
+	shm_ring writer = shm_ring::create(name, 42, sizeof(std::uint64_t), 4);
+	shm_ring reader;
+	ASSERT_TRUE(shm_ring::open(name, 42, sizeof(std::uint64_t), reader));
+	EXPECT_THROW(shm_ring::open(name, 43, sizeof(std::uint64_t), reader), std::runtime_error);
+
+	std::uint64_t next = 0;
+	std::uint64_t out = 0;
+	std::size_t size = 0;
+	EXPECT_EQ(reader.read(next, &out, size), shm_ring::read_result::empty);
+
+	for (std::uint64_t i = 0; i < 3; ++i) {
+		writer.write(&i);
+	}
+	for (std::uint64_t i = 0; i < 3; ++i) {
+		ASSERT_EQ(reader.read(next, &out, size), shm_ring::read_result::ok);
+		EXPECT_EQ(out, i);
+		EXPECT_EQ(size, sizeof(out));
+	}
+
+	// Overrun the 4 slots; the reader skips to the oldest event still there.
+	for (std::uint64_t i = 3; i < 10; ++i) {
+		writer.write(&i);
+	}
+	EXPECT_EQ(reader.read(next, &out, size), shm_ring::read_result::lapped);
+	ASSERT_EQ(reader.read(next, &out, size), shm_ring::read_result::ok);
+	EXPECT_EQ(out, 6);
+}
+
+TEST(ShmRing, CarriesEventsOfVaryingSize) {
+	const std::string name = "/illixr_test_varying_ring_" + std::to_string(getpid());
+	shm_ring writer = shm_ring::create(name, 42, 16, 4);
+	shm_ring reader;
+	// A reader of variable-size events takes the writer's slot size.
+	ASSERT_TRUE(shm_ring::open(name, 42, 0, reader));
+	ASSERT_EQ(reader.event_size(), 16);
+
+	writer.write("abc", 3);
+	writer.write("0123456789", 10);
+	std::uint64_t next = 0;
+	char out[16];
+	std::size_t size = 0;
+	ASSERT_EQ(reader.read(next, out, size), shm_ring::read_result::ok);
+	EXPECT_EQ(std::string(out, size), "abc");
+	ASSERT_EQ(reader.read(next, out, size), shm_ring::read_result::ok);
+	EXPECT_EQ(std::string(out, size), "0123456789");
+}
+
+TEST(ShmRing, RejectsSegmentsSmallerThanTheirHeaderClaims) {
+	const std::string name = "/illixr_test_truncated_ring_" + std::to_string(getpid());
+	shm_ring writer = shm_ring::create(name, 42, 1024, 4);
+	// Cut off most of the slots, as a foreign or damaged segment might be.
+	const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(ftruncate(fd, 1024), 0);
+	close(fd);
+	shm_ring reader;
+	EXPECT_THROW(shm_ring::open(name, 42, 1024, reader), std::runtime_error);
+}
+
+TEST(ShmRing, OpenFailsBeforeCreate) {
+	shm_ring reader;
+	EXPECT_FALSE(shm_ring::open("/illixr_test_absent_" + std::to_string(getpid()), 42, 8, reader));
+}
+
+TEST(ShmSwitchboard, ExportedTopicIsImportedByAnotherSwitchboard) {
+	// Two switchboards in one process stand in for two processes.
+	const std::string topic_name = "shm_test_" + std::to_string(getpid());
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+
+	setenv("ILLIXR_SHM_IMPORT", topic_name.c_str(), true);
+	std::shared_ptr<switchboard> importer = create_switchboard(&pb);
+	unsetenv("ILLIXR_SHM_IMPORT");
+	std::atomic<std::size_t> received {0};
+	std::atomic<std::size_t> last_seq {0};
+	importer->schedule<test_event>(1, topic_name, [&](const test_event* event) {
+		last_seq = event->seq;
+		received++;
+	});
+
+	setenv("ILLIXR_SHM_EXPORT", topic_name.c_str(), true);
+	std::shared_ptr<switchboard> exporter = create_switchboard(&pb);
+	unsetenv("ILLIXR_SHM_EXPORT");
+	auto writer = exporter->publish<test_event>(topic_name);
+
+	// The importer attaches some time after the segment appears, so keep publishing until it sees one.
+	std::size_t seq = 0;
+	EXPECT_TRUE(eventually([&]() {
+		auto ev = writer->allocate();
+		ev->seq = ++seq;
+		writer->put(ev);
+		return received.load() > 0;
+	}));
+	const std::size_t target = seq + 5;
+	while (seq < target) {
+		auto ev = writer->allocate();
+		ev->seq = ++seq;
+		writer->put(ev);
+	}
+	EXPECT_TRUE(eventually([&]() { return last_seq.load() == target; }));
+
+	importer->stop();
+	exporter->stop();
+}
+
+TEST(ShmSwitchboard, ImporterReattachesWhenTheExporterRestarts) {
+	const std::string topic_name = "shm_restart_test_" + std::to_string(getpid());
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+
+	setenv("ILLIXR_SHM_IMPORT", topic_name.c_str(), true);
+	std::shared_ptr<switchboard> importer = create_switchboard(&pb);
+	unsetenv("ILLIXR_SHM_IMPORT");
+	std::atomic<std::size_t> last_seq {0};
+	importer->schedule<test_event>(1, topic_name, [&](const test_event* event) {
+		last_seq = event->seq;
+	});
+
+	// Each exporter publishes its own range of sequence numbers, until the importer sees one of them.
+	auto export_until_seen = [&](std::size_t first_seq) {
+		setenv("ILLIXR_SHM_EXPORT", topic_name.c_str(), true);
+		std::shared_ptr<switchboard> exporter = create_switchboard(&pb);
+		unsetenv("ILLIXR_SHM_EXPORT");
+		auto writer = exporter->publish<test_event>(topic_name);
+		std::size_t seq = first_seq;
+		bool seen = false;
+		for (std::size_t tries = 0; tries < 300 && !seen; ++tries) {
+			auto ev = writer->allocate();
+			ev->seq = seq++;
+			writer->put(ev);
+			std::this_thread::sleep_for(std::chrono::milliseconds{10});
+			seen = last_seq.load() >= first_seq;
+		}
+		exporter->stop();
+		return seen;
+	};
+	EXPECT_TRUE(export_until_seen(1));
+	// The second exporter replaces the segment; the importer must notice, rather than keep reading the old one.
+	EXPECT_TRUE(export_until_seen(1000));
+
+	importer->stop();
+}
+
+/* Varies in size, like a camera frame. */
+struct blob_event {
+	std::string bytes;
+};
+
+template <>
+struct serializer<blob_event> {
+	static constexpr bool enabled = true;
+
+	static constexpr std::size_t fixed_size() {
+		return 0;
+	}
+
+	static std::size_t size(const blob_event& ev) {
+		return ev.bytes.size();
+	}
+
+	static void encode(const blob_event& ev, char* out) {
+		std::memcpy(out, ev.bytes.data(), ev.bytes.size());
+	}
+
+	static bool decode(const char* in, std::size_t size, blob_event& ev) {
+		ev.bytes.assign(in, size);
+		return true;
+	}
+};
+
+TEST(ShmSwitchboard, CarriesVariableSizeEventsUpToTheSlotSize) {
+	const std::string topic_name = "shm_blob_test_" + std::to_string(getpid());
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+	setenv("ILLIXR_SHM_MAX_EVENT_BYTES", "1024", true);
+
+	setenv("ILLIXR_SHM_IMPORT", topic_name.c_str(), true);
+	std::shared_ptr<switchboard> importer = create_switchboard(&pb);
+	unsetenv("ILLIXR_SHM_IMPORT");
+	std::vector<std::size_t> sizes;
+	std::mutex sizes_lock;
+	importer->schedule<blob_event>(1, topic_name, [&](const blob_event* event) {
+		const std::lock_guard<std::mutex> lock{sizes_lock};
+		sizes.push_back(event->bytes.size());
+	});
+
+	setenv("ILLIXR_SHM_EXPORT", topic_name.c_str(), true);
+	std::shared_ptr<switchboard> exporter = create_switchboard(&pb);
+	unsetenv("ILLIXR_SHM_EXPORT");
+	// The segment is created, with its slot size, when the topic is.
+	auto writer = exporter->publish<blob_event>(topic_name);
+	unsetenv("ILLIXR_SHM_MAX_EVENT_BYTES");
+	auto put = [&](std::size_t size) {
+		auto ev = writer->allocate();
+		ev->bytes.assign(size, 'x');
+		writer->put(ev);
+	};
+
+	// Wait for the importer to attach.
+	EXPECT_TRUE(eventually([&]() {
+		put(1);
+		const std::lock_guard<std::mutex> lock{sizes_lock};
+		return !sizes.empty();
+	}));
+	// Too big for a slot, so dropped; the events around it still arrive.
+	put(100);
+	put(2000);
+	put(1000);
+	EXPECT_TRUE(eventually([&]() {
+		const std::lock_guard<std::mutex> lock{sizes_lock};
+		return sizes.back() == 1000;
+	}));
+	importer->stop();
+	exporter->stop();
+	ASSERT_GE(sizes.size(), 2);
+	EXPECT_EQ(sizes[sizes.size() - 2], 100);
+}
+
+TEST(ShmSwitchboard, RejectsTypesWithoutASerializer) {
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+	setenv("ILLIXR_SHM_EXPORT", "shm_string", true);
+	std::shared_ptr<switchboard> sb = create_switchboard(&pb);
+	unsetenv("ILLIXR_SHM_EXPORT");
+	EXPECT_THROW(sb->publish<std::string>("shm_string"), std::runtime_error);
+	// The failed topic was not left behind, half set up.
+	EXPECT_THROW(sb->publish<std::string>("shm_string"), std::runtime_error);
+	EXPECT_TRUE(sb->get_topic_stats().empty());
+	sb->stop();
+}
+
+TEST(SwitchboardReplay, ReplaysRecordedEventsInOrder) {
+	const std::string path = "/tmp/illixr_test_replay_" + std::to_string(getpid()) + ".log";
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+
+	{
+		setenv("ILLIXR_SWITCHBOARD_RECORD", path.c_str(), true);
+		std::shared_ptr<switchboard> recorder = create_switchboard(&pb);
+		unsetenv("ILLIXR_SWITCHBOARD_RECORD");
+		auto writer = recorder->publish<test_event>("topic");
+		auto other = recorder->publish<std::size_t>("other");
+		for (std::size_t i = 0; i < 10; ++i) {
+			auto ev = writer->allocate();
+			ev->seq = i;
+			ev->payload[0] = i * 0.5;
+			writer->put(ev);
+			auto o = other->allocate();
+			*o = i;
+			other->put(o);
+		}
+		recorder->stop();
+	}
+
+	setenv("ILLIXR_SWITCHBOARD_REPLAY", path.c_str(), true);
+	setenv("ILLIXR_SWITCHBOARD_REPLAY_SPEED", "0", true);
+	auto replayer = std::dynamic_pointer_cast<switchboard_impl>(create_switchboard(&pb));
+	std::vector<std::size_t> seen;
+	std::mutex seen_lock;
+	replayer->schedule<test_event>(0, "topic", [&](const test_event* ev) {
+		EXPECT_EQ(ev->payload[0], ev->seq * 0.5);
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		seen.push_back(ev->seq);
+	});
+	// "other" has no local user, so its events are skipped.
+	replayer->start_replay();
+	unsetenv("ILLIXR_SWITCHBOARD_REPLAY");
+	unsetenv("ILLIXR_SWITCHBOARD_REPLAY_SPEED");
+
+	EXPECT_TRUE(eventually([&]() {
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		return seen.size() == 10;
+	}));
+	replayer->stop();
+	for (std::size_t i = 0; i < seen.size(); ++i) {
+		EXPECT_EQ(seen[i], i);
+	}
+	std::remove(path.c_str());
+}
+
+TEST(SwitchboardReplay, SkipsTopicsRecordedWithAnotherLayout) {
+	const std::string path = "/tmp/illixr_test_replay_layout_" + std::to_string(getpid()) + ".log";
+	const event_type& type = event_type::of<test_event>();
+	{
+		// As if test_event's fields had changed since the recording.
+		event_log::writer log {path};
+		const std::uint32_t topic_id = log.add_topic("topic", type.hash, type.layout + 1);
+		test_event ev {};
+		log.add_event(topic_id, type, &ev);
+	}
+
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+	setenv("ILLIXR_SWITCHBOARD_REPLAY", path.c_str(), true);
+	setenv("ILLIXR_SWITCHBOARD_REPLAY_SPEED", "0", true);
+	auto replayer = std::dynamic_pointer_cast<switchboard_impl>(create_switchboard(&pb));
+	std::atomic<std::size_t> received {0};
+	replayer->schedule<test_event>(0, "topic", [&](const test_event*) {
+		received++;
+	});
+	replayer->start_replay();
+	unsetenv("ILLIXR_SWITCHBOARD_REPLAY");
+	unsetenv("ILLIXR_SWITCHBOARD_REPLAY_SPEED");
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{50});
+	replayer->stop();
+	EXPECT_EQ(received.load(), 0);
+	std::remove(path.c_str());
+}
+
+TEST_F(ILLIXRSwitchboard, HigherPriorityClassesAreServedFirst) {
+	setenv("ILLIXR_SWITCHBOARD_THREADS", "1", true);
+	sb->stop();
+	sb = create_switchboard(&pb);
+	unsetenv("ILLIXR_SWITCHBOARD_THREADS");
+
+	std::atomic<bool> release {false};
+	std::atomic<bool> started {false};
+	std::vector<std::string> order;
+	std::mutex order_lock;
+	auto record = [&](std::string name) {
+		const std::lock_guard<std::mutex> lock{order_lock};
+		order.push_back(name);
+	};
+	sb->schedule<test_event>(0, "stall", [&](const test_event*) {
+		started = true;
+		while (!release) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+	});
+	sb->schedule<test_event>(0, "background", [&](const test_event*) { record("background"); }, {256, overflow_policy::block, priority_class::background});
+	sb->schedule<test_event>(0, "normal", [&](const test_event*) { record("normal"); });
+	sb->schedule<test_event>(0, "realtime", [&](const test_event*) { record("realtime"); }, {256, overflow_policy::block, priority_class::realtime});
+
+	// Occupy the only worker, then queue one event per class, lowest first.
+	auto stall = sb->publish<test_event>("stall");
+	stall->put(stall->allocate());
+	ASSERT_TRUE(eventually([&] { return started.load(); }));
+	for (const char* topic_name : {"background", "normal", "realtime"}) {
+		auto writer = sb->publish<test_event>(topic_name);
+		writer->put(writer->allocate());
+	}
+	release = true;
+
+	EXPECT_TRUE(eventually([&] {
+		const std::lock_guard<std::mutex> lock{order_lock};
+		return order.size() == 3;
+	}));
+	sb->stop();
+	EXPECT_EQ(order, (std::vector<std::string>{"realtime", "normal", "background"}));
+}
+
+TEST_F(ILLIXRSwitchboard, StarvedBackgroundSubscriberDoesNotBlockWriter) {
+	setenv("ILLIXR_SWITCHBOARD_THREADS", "1", true);
+	sb->stop();
+	sb = create_switchboard(&pb);
+	unsetenv("ILLIXR_SWITCHBOARD_THREADS");
+
+	std::atomic<bool> release {false};
+	std::atomic<bool> started {false};
+	std::vector<std::size_t> seen;
+	std::mutex seen_lock;
+	sb->schedule<test_event>(0, "stall", [&](const test_event*) {
+		started = true;
+		while (!release) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+	});
+	// Like debugview's visualization of imu_cam.
+	sb->schedule<test_event>(0, "topic", [&](const test_event* ev) {
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		seen.push_back(ev->seq);
+	}, {4, overflow_policy::drop_oldest, priority_class::background});
+
+	// Occupy the only worker, so that the background callback never runs.
+	auto stall = sb->publish<test_event>("stall");
+	stall->put(stall->allocate());
+	ASSERT_TRUE(eventually([&] { return started.load(); }));
+
+	std::atomic<bool> written {false};
+	std::thread writer_thread {[&]() {
+		auto writer = sb->publish<test_event>("topic");
+		for (std::size_t i = 0; i < 100; ++i) {
+			auto ev = writer->allocate();
+			ev->seq = i;
+			writer->put(ev);
+		}
+		written = true;
+	}};
+	EXPECT_TRUE(eventually([&] { return written.load(); }));
+	release = true;
+	writer_thread.join();
+
+	// Once served, it sees only the latest events.
+	EXPECT_TRUE(eventually([&] {
+		const std::lock_guard<std::mutex> lock{seen_lock};
+		return !seen.empty() && seen.back() == 99;
+	}));
+	sb->stop();
+	EXPECT_LE(seen.size(), 4);
+}
+
+TEST_F(ILLIXRSwitchboard, RealtimeWorkersAreNotDelayedByOthers) {
+	setenv("ILLIXR_SWITCHBOARD_THREADS", "1", true);
+	setenv("ILLIXR_SWITCHBOARD_RT_THREADS", "1", true);
+	sb->stop();
+	sb = create_switchboard(&pb);
+	unsetenv("ILLIXR_SWITCHBOARD_THREADS");
+	unsetenv("ILLIXR_SWITCHBOARD_RT_THREADS");
+
+	std::atomic<bool> release {false};
+	std::atomic<std::size_t> realtime_calls {0};
+	sb->schedule<test_event>(0, "topic", [&](const test_event*) {
+		while (!release) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+	});
+	sb->schedule<test_event>(1, "topic", [&](const test_event*) {
+		realtime_calls++;
+	}, {256, overflow_policy::block, priority_class::realtime});
+
+	auto writer = sb->publish<test_event>("topic");
+	for (std::size_t i = 0; i < 3; ++i) {
+		writer->put(writer->allocate());
+	}
+	// The only normal worker is stalled, yet the realtime callback keeps up.
+	EXPECT_TRUE(eventually([&] { return realtime_calls.load() == 3; }));
+	release = true;
+	// The callbacks refer to locals, so join the workers before they go out of scope.
+	sb->stop();
+}
+
+
+/* Keeps the switchboard_trace records. */
+class trace_record_logger : public record_logger {
+public:
+	struct hop {
+		std::string topic_name;
+		std::size_t trace_id;
+		std::string parent_topic_name;
+		std::chrono::nanoseconds hop_latency;
+		std::chrono::nanoseconds origin_latency;
+	};
+
+	virtual void log(const record& r) override {
+		r.mark_used();
+		if (r.get_record_header().get_name() == "switchboard_trace") {
+			const std::lock_guard<std::mutex> lock{mutex};
+			hops.push_back(hop{
+				r.get_value<std::string>(0),
+				r.get_value<std::size_t>(1),
+				r.get_value<std::string>(2),
+				r.get_value<std::chrono::nanoseconds>(3),
+				r.get_value<std::chrono::nanoseconds>(4),
+			});
+		}
+	}
+
+	std::vector<hop> get() {
+		const std::lock_guard<std::mutex> lock{mutex};
+		return hops;
+	}
+
+private:
+	std::mutex mutex;
+	std::vector<hop> hops;
+};
+
+TEST(SwitchboardTrace, FollowsEventsThroughCallbacksAndReads) {
+	auto logger = std::make_shared<trace_record_logger>();
+	phonebook pb;
+	pb.register_impl<record_logger>(logger);
+	setenv("ILLIXR_SWITCHBOARD_TRACE", "y", true);
+	std::shared_ptr<switchboard> sb = create_switchboard(&pb);
+	unsetenv("ILLIXR_SWITCHBOARD_TRACE");
+	// Forget whatever this thread read in earlier tests.
+	trace_context::reset();
+
+	auto first = sb->publish<test_event>("first");
+	auto second = sb->publish<test_event>("second");
+	auto third = sb->publish<test_event>("third");
+	auto second_reader = sb->subscribe_latest<test_event>("second");
+	sb->schedule<test_event>(0, "first", [&](const test_event* ev) {
+		auto out = second->allocate();
+		out->seq = ev->seq;
+		second->put(out);
+	});
+
+	// Nothing caused this put, so it starts a trace without logging a hop.
+	first->put(first->allocate());
+	ASSERT_TRUE(eventually([&] { return logger->get().size() == 1; }));
+
+	// This thread acts on "second", so what it publishes continues the same trace.
+	ASSERT_NE(second_reader->get_latest_ro(), nullptr);
+	third->put(third->allocate());
+
+	const std::vector<trace_record_logger::hop> hops = logger->get();
+	ASSERT_EQ(hops.size(), 2);
+	EXPECT_EQ(hops[0].topic_name, "second");
+	EXPECT_EQ(hops[0].parent_topic_name, "first");
+	EXPECT_EQ(hops[1].topic_name, "third");
+	EXPECT_EQ(hops[1].parent_topic_name, "second");
+	EXPECT_EQ(hops[0].trace_id, hops[1].trace_id);
+	EXPECT_GE(hops[1].origin_latency, hops[0].origin_latency);
+	EXPECT_GE(hops[1].origin_latency, hops[1].hop_latency);
+	sb->stop();
+}
+
+
+TEST_F(ILLIXRSwitchboard, PutBulkDeliversEveryEventInOrder) {
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe_latest<test_event>("topic");
+	std::mutex mutex;
+	std::vector<std::size_t> seen;
+	sb->schedule<test_event>(0, "topic", [&](const test_event* ev) {
+		const std::lock_guard<std::mutex> lock{mutex};
+		seen.push_back(ev->seq);
+	});
+
+	// More than one chunk of the typed wrapper.
+	std::vector<std::shared_ptr<test_event>> events;
+	for (std::size_t i = 0; i < 100; ++i) {
+		events.push_back(writer->allocate());
+		events.back()->seq = i;
+	}
+	writer->put_bulk(events);
+	ASSERT_EQ(reader->get_latest_ro()->seq, 99);
+
+	ASSERT_TRUE(eventually([&] {
+		const std::lock_guard<std::mutex> lock{mutex};
+		return seen.size() == 100;
+	}));
+	for (std::size_t i = 0; i < seen.size(); ++i) {
+		ASSERT_EQ(seen[i], i);
+	}
+}
+
+TEST_F(ILLIXRSwitchboard, ScheduleBatchCoalescesPendingEvents) {
+	auto writer = sb->publish<test_event>("topic");
+	std::atomic<bool> release {false};
+	std::mutex mutex;
+	std::vector<std::size_t> seen;
+	std::vector<std::size_t> batch_sizes;
+	sb->schedule_batch<test_event>(0, "topic", [&](const event_batch<test_event>& batch) {
+		// Hold up the first batch, so the rest pile up behind it.
+		while (!release.load()) {
+			std::this_thread::yield();
+		}
+		const std::lock_guard<std::mutex> lock{mutex};
+		batch_sizes.push_back(batch.size());
+		for (const test_event& ev : batch) {
+			seen.push_back(ev.seq);
+		}
+	}, 8);
+
+	for (std::size_t i = 0; i < 20; ++i) {
+		auto ev = writer->allocate();
+		ev->seq = i;
+		writer->put(ev);
+	}
+	release = true;
+
+	ASSERT_TRUE(eventually([&] {
+		const std::lock_guard<std::mutex> lock{mutex};
+		return seen.size() == 20;
+	}));
+	for (std::size_t i = 0; i < seen.size(); ++i) {
+		ASSERT_EQ(seen[i], i);
+	}
+	for (std::size_t size : batch_sizes) {
+		ASSERT_LE(size, 8);
+	}
+	// The first batch may have been taken before the others arrived, but the rest came together.
+	ASSERT_LE(batch_sizes.size(), 4);
+}
+
+
+/* Counts its iterations, and exposes the wake sources. */
+class counting_threadloop : public threadloop {
+public:
+	explicit counting_threadloop(phonebook* pb_)
+		: threadloop{"counting_threadloop", pb_}
+	{ }
+
+	using threadloop::wake_on;
+	using threadloop::wake_every;
+	using threadloop::wake_at;
+	using threadloop::run_as_tasks;
+
+	std::atomic<std::size_t> iterations {0};
+	std::atomic<std::chrono::steady_clock::time_point> first_iteration {};
+
+protected:
+	virtual void _p_one_iteration() override {
+		if (iterations++ == 0) {
+			first_iteration = std::chrono::steady_clock::now();
+		}
+	}
+};
+
+TEST_F(ILLIXRSwitchboard, ThreadloopWakesOnTopic) {
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	auto writer = sb->publish<test_event>("topic");
+	auto reader = sb->subscribe<test_event>("topic");
+	std::shared_ptr<const test_event> latest;
+	counting_threadloop loop {&pb};
+	loop.wake_on(*reader, latest);
+	loop.start();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{20});
+	ASSERT_EQ(loop.iterations.load(), 0);
+	for (std::size_t i = 0; i < 3; ++i) {
+		writer->put(writer->allocate());
+		ASSERT_TRUE(eventually([&] { return loop.iterations.load() == i + 1; }));
+	}
+	loop.stop();
+}
+
+TEST_F(ILLIXRSwitchboard, ThreadloopWakesPeriodically) {
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	counting_threadloop loop {&pb};
+	loop.wake_every(std::chrono::milliseconds{10});
+	loop.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds{105});
+	loop.stop();
+	// Neither spinning nor drifting; a wake-up may be missed under a loaded test machine.
+	ASSERT_GE(loop.iterations.load(), 7);
+	ASSERT_LE(loop.iterations.load(), 10);
+}
+
+TEST_F(ILLIXRSwitchboard, ThreadloopWakesAtDeadline) {
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	counting_threadloop loop {&pb};
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{30};
+	loop.wake_at(deadline);
+	loop.start();
+	std::this_thread::sleep_for(std::chrono::milliseconds{80});
+	// Stopping must not wait for a deadline which was never set.
+	loop.stop();
+	ASSERT_EQ(loop.iterations.load(), 1);
+	ASSERT_GE(loop.first_iteration.load(), deadline);
+}
+
+
+class overrun_record_logger : public record_logger {
+public:
+	virtual void log(const record& r) override {
+		r.mark_used();
+		if (r.get_record_header().get_name() == "threadloop_overrun") {
+			++(r.get_value<bool>(4) ? skipped : late);
+		}
+	}
+
+	std::atomic<std::size_t> late {0};
+	std::atomic<std::size_t> skipped {0};
+};
+
+class slow_threadloop : public threadloop {
+public:
+	explicit slow_threadloop(phonebook* pb_)
+		: threadloop{"slow_threadloop", pb_}
+	{ }
+
+	using threadloop::wake_every;
+	using threadloop::set_deadline;
+	using threadloop::overrun_policy;
+
+	std::atomic<std::size_t> iterations {0};
+
+protected:
+	virtual void _p_one_iteration() override {
+		std::this_thread::sleep_for(std::chrono::milliseconds{8});
+		++iterations;
+	}
+};
+
+TEST(ThreadloopDeadline, LogsOverruns) {
+	auto logger = std::make_shared<overrun_record_logger>();
+	phonebook pb;
+	pb.register_impl<record_logger>(logger);
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	{
+		slow_threadloop loop {&pb};
+		loop.wake_every(std::chrono::milliseconds{10});
+		loop.set_deadline(std::chrono::milliseconds{5});
+		loop.start();
+		std::this_thread::sleep_for(std::chrono::milliseconds{100});
+		loop.stop();
+		ASSERT_GT(loop.iterations.load(), 0);
+		// The thread's records are flushed when it exits.
+		EXPECT_EQ(logger->late.load(), loop.iterations.load());
+		EXPECT_EQ(logger->skipped.load(), 0);
+	}
+}
+
+TEST(ThreadloopDeadline, SkipsStaleIterations) {
+	auto logger = std::make_shared<overrun_record_logger>();
+	phonebook pb;
+	pb.register_impl<record_logger>(logger);
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	{
+		slow_threadloop loop {&pb};
+		loop.wake_every(std::chrono::milliseconds{10});
+		loop.set_deadline(std::chrono::milliseconds{5}, slow_threadloop::overrun_policy::skip_stale);
+		loop.start();
+		std::this_thread::sleep_for(std::chrono::milliseconds{300});
+		loop.stop();
+		// Once it has learned that an iteration takes longer than the deadline, it skips most.
+		EXPECT_GT(logger->skipped.load(), 0);
+		EXPECT_LT(loop.iterations.load(), 25);
+		EXPECT_EQ(logger->late.load(), loop.iterations.load());
+	}
+}
+
+class ingesting_threadloop : public threadloop {
+public:
+	explicit ingesting_threadloop(phonebook* pb_)
+		: threadloop{"ingesting_threadloop", pb_}
+	{ }
+
+	using threadloop::wake_every;
+	using threadloop::set_deadline;
+
+	std::atomic<std::size_t> ingested {0};
+	std::atomic<std::size_t> outputs {0};
+
+protected:
+	virtual void _p_one_iteration() override {
+		++ingested;
+		if (iteration_is_stale()) {
+			return;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{8});
+		++outputs;
+	}
+};
+
+TEST(ThreadloopDeadline, StaleIterationsStillIngest) {
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	{
+		ingesting_threadloop loop {&pb};
+		loop.wake_every(std::chrono::milliseconds{10});
+		loop.set_deadline(std::chrono::milliseconds{5});
+		loop.start();
+		std::this_thread::sleep_for(std::chrono::milliseconds{300});
+		loop.stop();
+		// Every wake-up takes its input, but once the slow part is known to overrun, it is skipped.
+		EXPECT_GE(loop.ingested.load(), 20);
+		EXPECT_GT(loop.outputs.load(), 0);
+		EXPECT_LT(loop.outputs.load(), loop.ingested.load());
+	}
+}
+
+TEST(Executor, RunsSwitchboardAndThreadloops) {
+	phonebook pb;
+	pb.register_impl<record_logger>(std::make_shared<noop_record_logger>());
+	pb.register_impl<gen_guid>(std::make_shared<gen_guid>());
+	auto exec = std::make_shared<executor>(2);
+	pb.register_impl<executor>(exec);
+	setenv("ILLIXR_EXECUTOR", "y", true);
+	std::shared_ptr<switchboard> sb = create_switchboard(&pb);
+
+	auto writer = sb->publish<test_event>("topic");
+	std::vector<std::size_t> seen;
+	std::atomic<std::size_t> count {0};
+	sb->schedule<test_event>(0, "topic", [&](const std::shared_ptr<const test_event>& ev) {
+		seen.push_back(ev->seq);
+		count++;
+	});
+
+	auto reader = sb->subscribe<test_event>("topic");
+	std::shared_ptr<const test_event> latest;
+	counting_threadloop on_topic {&pb};
+	on_topic.wake_on(*reader, latest);
+	on_topic.run_as_tasks();
+	on_topic.start();
+	counting_threadloop periodic {&pb};
+	periodic.wake_every(std::chrono::milliseconds{10});
+	periodic.run_as_tasks();
+	const auto periodic_start = std::chrono::steady_clock::now();
+	periodic.start();
+	unsetenv("ILLIXR_EXECUTOR");
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{20});
+	ASSERT_EQ(on_topic.iterations.load(), 0);
+	for (std::size_t i = 0; i < 100; ++i) {
+		auto ev = writer->allocate();
+		ev->seq = i;
+		writer->put(ev);
+	}
+	ASSERT_TRUE(eventually([&] { return count.load() == 100; }));
+	ASSERT_TRUE(eventually([&] { return on_topic.iterations.load() > 0; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds{50});
+
+	on_topic.stop();
+	periodic.stop();
+	const auto periodic_time = std::chrono::steady_clock::now() - periodic_start;
+	sb->stop();
+	exec->stop();
+
+	// Still in order, one at a time, without a worker of its own.
+	for (std::size_t i = 0; i < seen.size(); ++i) {
+		EXPECT_EQ(seen[i], i);
+	}
+	// Paced by the executor's timers, neither spinning nor stalling.
+	EXPECT_GE(periodic.iterations.load(), 4);
+	EXPECT_LE(periodic.iterations.load(), std::size_t(periodic_time / std::chrono::milliseconds{10}));
+}
+
+}
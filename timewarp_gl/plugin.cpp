@@ -274,7 +274,8 @@ public:
 		// MTP here. More you wait, closer to the display sync you sample the pose.
 
 		// TODO: poll GLX window events
-		std::this_thread::sleep_for(std::chrono::duration<double>(EstimateTimeToSleep(DELAY_FRACTION)));
+		// Any overshoot of this sleep comes out of the remaining (1 - DELAY_FRACTION) of the frame, so sleep precisely.
+		sleeper().sleep_for(EstimateTimeToSleep(DELAY_FRACTION));
 		if(_m_eyebuffer->get_latest_ro()) {
 			return skip_option::run;
 		} else {
@@ -523,7 +524,7 @@ public:
 		printf("\033[1;36m[TIMEWARP]\033[0m Warping from swap %d\n", most_recent_frame->swap_indices[0]);
 #endif
 		// Call Hologram
-		auto hologram_params = new hologram_input;
+		auto hologram_params = _m_hologram->allocate();
 		hologram_params->seq = ++_hologram_seq;
 		_m_hologram->put(hologram_params);
 
@@ -537,7 +538,9 @@ public:
 		lastSwapTime = std::chrono::high_resolution_clock::now();
 
 		// Now that we have the most recent swap time, we can publish the new estimate.
-		_m_vsync_estimate->put(new time_type(GetNextSwapTimeEstimate()));
+		auto vsync_estimate = _m_vsync_estimate->allocate();
+		*vsync_estimate = GetNextSwapTimeEstimate();
+		_m_vsync_estimate->put(vsync_estimate);
 
 #ifndef NDEBUG
 		auto afterSwap = glfwGetTime();
@@ -19,8 +19,8 @@ const record_header __imu_cam_record {"imu_cam", {
 }};
 
 typedef struct {
-    cv::Mat* img0;
-    cv::Mat* img1;
+    cv::Mat img0;
+    cv::Mat img1;
     std::size_t serial_no;
 } cam_type;
 
@@ -92,12 +92,15 @@ protected:
         auto start_cpu_time  = thread_cpu_time();
         auto start_wall_time = std::chrono::high_resolution_clock::now();
 
-        _m_cam_type->put(new cam_type{
-            // Make a copy, so that we don't have race
-            new cv::Mat{imageL_ocv},
-            new cv::Mat{imageR_ocv},
+        auto cam = _m_cam_type->allocate();
+        *cam = cam_type{
+            // Make a deep copy, so that we don't race with the next retrieveImage.
+            // (Copying a cv::Mat only copies the header.)
+            imageL_ocv.clone(),
+            imageR_ocv.clone(),
             iteration_no,
-        });
+        };
+        _m_cam_type->put(cam);
     }
 };
 
@@ -116,7 +119,6 @@ public:
         , zedm{start_camera()}
         , camera_thread_{"zed_camera_thread", pb_, zedm}
         , _m_cam_type{sb->subscribe_latest<cam_type>("cam_type")}
-        , _m_imu_integrator{sb->publish<imu_integrator_seq>("imu_integrator_seq")}
         , it_log{record_logger_}
     {
         camera_thread_.start();
@@ -152,10 +154,10 @@ protected:
         la = {sensors_data.imu.linear_acceleration_uncalibrated.x , sensors_data.imu.linear_acceleration_uncalibrated.y, sensors_data.imu.linear_acceleration_uncalibrated.z };
         av = {sensors_data.imu.angular_velocity_uncalibrated.x  * (M_PI/180), sensors_data.imu.angular_velocity_uncalibrated.y * (M_PI/180), sensors_data.imu.angular_velocity_uncalibrated.z * (M_PI/180)};
 
-        std::optional<cv::Mat*> img0 = std::nullopt;
-        std::optional<cv::Mat*> img1 = std::nullopt;
+        std::optional<cv::Mat> img0 = std::nullopt;
+        std::optional<cv::Mat> img1 = std::nullopt;
 
-        const cam_type* c = _m_cam_type->get_latest_ro();
+        auto c = _m_cam_type->get_latest_ro();
         if (c && c->serial_no != last_serial_no) {
             last_serial_no = c->serial_no;
             img0 = c->img0;
@@ -167,19 +169,16 @@ protected:
             {bool(img0)},
         }});
 
-        _m_imu_cam->put(new imu_cam_type {
+        auto datum = _m_imu_cam->allocate();
+        *datum = imu_cam_type {
             imu_time_point,
             av,
             la,
             img0,
             img1,
             imu_time,
-        });
-
-        auto imu_integrator_params = new imu_integrator_seq{
-			.seq = static_cast<int>(++_imu_integrator_seq),
-		};
-		_m_imu_integrator->put(imu_integrator_params);
+        };
+        _m_imu_cam->put(datum);
 
         last_imu_ts = sensors_data.imu.timestamp;
     }
@@ -191,7 +190,6 @@ private:
     const std::shared_ptr<switchboard> sb;
     std::unique_ptr<writer<imu_cam_type>> _m_imu_cam;
     std::unique_ptr<reader_latest<cam_type>> _m_cam_type;
-    std::unique_ptr<writer<imu_integrator_seq>> _m_imu_integrator;
 
     // IMU
     SensorsData sensors_data;
@@ -204,7 +202,6 @@ private:
     ullong imu_time;
 
     std::size_t last_serial_no {0};
-    long long _imu_integrator_seq{0};
 
     // Logger
     record_coalescer it_log;